@@ -3,6 +3,9 @@
  * @author cF-embedded (cf@embedded.pl)
  * @brief Battery bitmap to show percent of vbat
  *
+ * Input of bitmap_pages.py only, firmware uses generated bitmap_pages.h
+ * and positions from display_layout.h.
+ *
  * @copyright Copyright (c) 2024
  *
  */
@@ -16,23 +19,13 @@ extern "C"
 {
 #endif /* __cplusplus */
 
-/* Start of battery bitmap on oled x axis */
-#define BATTERY_BITMAP_AREA_X 1
-/* Start of battery bitmap on oled y axis */
-#define BATTERY_BITMAP_AREA_Y 1
-
 /* Battery bitmap width on oled display */
 #define BATTERY_BITMAP_AREA_WIDTH 80
 /* Battery bitmap height on oled display */
 #define BATTERY_BITMAP_AREA_HEIGHT 64
 
-/* Start of speed string on oled x axis */
-#define BATTERY_STRING_AREA_X 90
-/* Start of speed string on oled y axis */
-#define BATTERY_STRING_AREA_Y 32
-
 
-    const uint8_t battery_bitmap[] = {
+    static const uint8_t battery_bitmap[] = {
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -9,18 +9,43 @@
  */
 
 #include "display.h"
-#include "battery_bitmap.h"
-#include "hm_10.h"
+#include "battery.h"
+#include "bitmap_pages.h"
+#include "button.h"
+#include "display_layout.h"
 #include "i2c_master.h"
+#include "latency_stats.h"
 #include "platform_specific.h"
-#include "speedometer_bitmap.h"
 #include "ssd1306.h"
+#include "ssd1306_fonts.h"
+#include "telemetry_task.h"
 #include "stdio.h"
 #include "string.h"
 
+/* Minimum time between frames in ms, changes within it are drawn in one frame */
+#define DISPLAY_MIN_FRAME_MS 40
+
+/* Maximum time without redraw in ms */
+#define DISPLAY_MAX_STALE_MS 1000
+
+/* Battery voltage change causing redraw in mV, half of displayed resolution */
+#define DISPLAY_BATTERY_THRESHOLD_MV 50
+
+/* Notification bits of display task, BUTTON_EVENT_ bits are used by button */
+#define DISPLAY_EVENT_TELEMETRY (1 << 8)
+#define DISPLAY_EVENT_BATTERY (1 << 9)
+
 static TaskHandle_t display_handle;
 
-static bool is_button_pressed = false;
+/* Memory of display task, used by ssd1306 initialization first */
+static task_stack_t display_stack[DISPLAY_STACKSIZE];
+static task_buf_t display_task_buf;
+
+/* Telemetry used by frame being drawn */
+static struct telemetry_snapshot telemetry;
+
+/* Reception time of the latest speed change already drawn */
+static uint32_t drawn_speed_changed_time;
 
 typedef enum
 {
@@ -48,87 +73,117 @@ static void display_show_battery_screen(void);
 static void display_task(void* params);
 
 /**
- * @brief ssd1306 initalization, deleted after init.
+ * @brief Add telemetry to pixel latency of flushed frame
  *
- * @param params Task parameters - unused
+ * @param tag - reception time of telemetry change shown by the frame, 0 if none
  */
-static void ssd1306_init_task(void* params);
+static void display_flush_done(uint32_t tag);
 
 void display_tasks_init(void)
 {
     i2c_master_init();
+    ssd1306_task_init();
 
-    rtos_task_create(ssd1306_init_task, "ssd1306_init", SSD1306_INIT_STACKSIZE, SSD1306_INIT_PRIORITY, NULL);
-    rtos_task_create(display_task, "display", DISPLAY_STACKSIZE, DISPLAY_PRIORITY, &display_handle);
+    /* Priority is lowered after ssd1306 initialization, first frame isn't delayed by other startup steps */
+    display_handle = rtos_task_create_static(display_task, "display", DISPLAY_STACKSIZE, SSD1306_INIT_PRIORITY, display_stack, &display_task_buf);
+
+    ssd1306_set_flush_callback(display_flush_done);
 }
 
 void display_show_speedometer_screen(void)
 {
-    static uint8_t speed = 0;
-    static uint8_t* speed_string[4];
+    char speed_string[6];
 
-    ssd1306_draw_bitmap(SPEEDOMETER_BITMAP_AREA_X, SPEEDOMETER_BITMAP_AREA_Y, SPEEDOMETER_BITMAP_AREA_WIDTH, SPEEDOMETER_BITMAP_AREA_HEIGHT, speedometer_bitmap);
+    ssd1306_draw_pages(SPEEDOMETER_BITMAP_AREA_X,
+                       SPEEDOMETER_BITMAP_PAGES_FIRST,
+                       SPEEDOMETER_BITMAP_PAGES_WIDTH,
+                       SPEEDOMETER_BITMAP_PAGES_COUNT,
+                       speedometer_bitmap_pages);
 
-    ssd1306_draw_bitmap(MPH_BITMAP_AREA_X, MPH_BITMAP_AREA_Y, MPH_BITMAP_AREA_WIDTH, MPH_BITMAP_AREA_HEIGHT, mph_bitmap);
+    ssd1306_draw_pages(MPH_BITMAP_AREA_X, MPH_BITMAP_PAGES_FIRST, MPH_BITMAP_PAGES_WIDTH, MPH_BITMAP_PAGES_COUNT, mph_bitmap_pages);
 
-    hm_10_read_buf(&speed, 1);
+    snprintf(speed_string, sizeof(speed_string), "%3u", telemetry.state.speed);
 
-    ssd1306_draw_string(SPEEDOMETER_STRING_AREA_X, SPEEDOMETER_STRING_AREA_Y, "137");
+    ssd1306_draw_text(SPEEDOMETER_STRING_AREA_X, SPEEDOMETER_STRING_AREA_Y, speed_string, &ssd1306_font_digits_10x14);
 }
 
 void display_show_battery_screen(void)
 {
-    uint8_t* vbat_str[5];
+    char vbat_str[8];
 
-    ssd1306_draw_bitmap(BATTERY_BITMAP_AREA_X, BATTERY_BITMAP_AREA_Y, BATTERY_BITMAP_AREA_WIDTH, BATTERY_BITMAP_AREA_HEIGHT, battery_bitmap);
+    ssd1306_draw_pages(BATTERY_BITMAP_AREA_X, BATTERY_BITMAP_PAGES_FIRST, BATTERY_BITMAP_PAGES_WIDTH, BATTERY_BITMAP_PAGES_COUNT, battery_bitmap_pages);
 
-    float vbat = 2.9;
+    int32_t vbat_mv = battery_get_mv();
 
-    snprintf(vbat_str, sizeof(vbat_str), "%.1f", vbat);
-    strcat(vbat_str, "V");
+    if(vbat_mv < 0)
+    {
+        strcpy(vbat_str, "-.-V");
+    }
+    else
+    {
+        /* Rounded to 0.1 V without float formatting */
+        vbat_mv += 50;
+        snprintf(vbat_str, sizeof(vbat_str), "%ld.%ldV", (long)(vbat_mv / 1000), (long)((vbat_mv % 1000) / 100));
+    }
 
     ssd1306_draw_string(BATTERY_STRING_AREA_X, BATTERY_STRING_AREA_Y, vbat_str);
 }
 
-static void ssd1306_init_task(void* params)
+static void display_flush_done(uint32_t tag)
 {
-    (void)params;
-
-    ssd1306_init();
-    /* Resume display task after ssd1306 init */
-    vTaskResume(display_handle);
-    /* Suspend ssd1306_init_task */
-    vTaskSuspend(NULL);
+    if(tag != 0)
+    {
+        latency_stats_add(tag);
+    }
 }
 
 static void display_task(void* params)
 {
     (void)params;
 
-    tick_t ticks;
+    tick_t last_frame;
+    uint32_t events = 0;
 
     display_screen_e_t act_screen = BATTERY_SCREEN;
 
-    /* Suspend display task befor ssd1306 initialize */
-    vTaskSuspend(NULL);
+    ssd1306_init();
+
+    /* Events are registered after init, which waits for I2C on notifications of this task */
+    button_set_notify(display_handle);
+    telemetry_set_notify(display_handle, DISPLAY_EVENT_TELEMETRY);
+    battery_set_notify(display_handle, DISPLAY_EVENT_BATTERY, DISPLAY_BATTERY_THRESHOLD_MV);
+
+    rtos_task_priority_set(NULL, DISPLAY_PRIORITY);
+
     while(1)
     {
-        ticks = rtos_tick_count_get();
-
-        if(is_button_pressed)
+        /* Frames are drawn over the previous one, screen is cleared only when layout changes */
+        if((events & BUTTON_EVENT_SHORT) != 0)
         {
             if(act_screen == SPEEDOMETER_SCREEN)
             {
                 act_screen = BATTERY_SCREEN;
                 ssd1306_clear_screen();
-                ssd1306_update_screen();
             }
 
             else if(act_screen == BATTERY_SCREEN)
             {
                 act_screen = SPEEDOMETER_SCREEN;
                 ssd1306_clear_screen();
-                ssd1306_update_screen();
+            }
+        }
+
+        /* Latest values, link latency doesn't hold drawing */
+        telemetry_snapshot_get(&telemetry);
+
+        /* Each speed change is measured only in the first frame showing it, only speed screen shows it */
+        if(telemetry.speed_changed_time != drawn_speed_changed_time)
+        {
+            drawn_speed_changed_time = telemetry.speed_changed_time;
+
+            if(act_screen == SPEEDOMETER_SCREEN)
+            {
+                ssd1306_set_frame_tag(drawn_speed_changed_time);
             }
         }
 
@@ -147,8 +202,19 @@ static void display_task(void* params)
             }
         }
 
-        ssd1306_update_screen();
+        /* Frame is sent in background while next one is drawn */
+        ssd1306_swap_buffers();
+
+        last_frame = rtos_tick_count_get();
+
+        /* Sleep until something shown changes, redraw anyway after max staleness */
+        events = 0;
+        rtos_task_notify_bits_wait(&events, DISPLAY_MAX_STALE_MS);
 
-        rtos_delay_until(&ticks, 100);
+        /* Limit frame rate and merge events which came meanwhile */
+        uint32_t more_events = 0;
+        rtos_delay_until(&last_frame, DISPLAY_MIN_FRAME_MS);
+        rtos_task_notify_bits_wait(&more_events, 0);
+        events |= more_events;
     }
 }
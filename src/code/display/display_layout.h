@@ -0,0 +1,40 @@
+/**
+ * @file display_layout.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Positions of bitmaps and strings on oled screens
+ *
+ * Included by display.c and read by bitmap_pages.py, bitmap data stays in
+ * *_bitmap.h headers used only for conversion.
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef _DISPLAY_LAYOUT_H
+#define _DISPLAY_LAYOUT_H
+
+/* Start of speedometer bitmap on oled x axis */
+#define SPEEDOMETER_BITMAP_AREA_X 1
+/* Start of speedometer bitmap on oled y axis */
+#define SPEEDOMETER_BITMAP_AREA_Y 1
+
+/* Start of mph bitmap on oled x axis */
+#define MPH_BITMAP_AREA_X 93
+/* Start of mph bitmap on oled y axis */
+#define MPH_BITMAP_AREA_Y 46
+
+/* Start of speed string on oled x axis */
+#define SPEEDOMETER_STRING_AREA_X 90
+/* Start of speed string on oled y axis, page aligned for large digits */
+#define SPEEDOMETER_STRING_AREA_Y 24
+
+/* Start of battery bitmap on oled x axis */
+#define BATTERY_BITMAP_AREA_X 1
+/* Start of battery bitmap on oled y axis */
+#define BATTERY_BITMAP_AREA_Y 1
+
+/* Start of battery voltage string on oled x axis */
+#define BATTERY_STRING_AREA_X 90
+/* Start of battery voltage string on oled y axis */
+#define BATTERY_STRING_AREA_Y 32
+
+#endif /* _DISPLAY_LAYOUT_H */
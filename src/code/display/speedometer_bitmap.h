@@ -3,6 +3,9 @@
  * @author cF-embedded (cf@embedded.pl)
  * @brief speedometer bitmap to show rc car velocity
  *
+ * Input of bitmap_pages.py only, firmware uses generated bitmap_pages.h
+ * and positions from display_layout.h.
+ *
  * @copyright Copyright (c) 2024
  *
  */
@@ -16,32 +19,18 @@ extern "C"
 {
 #endif /* __cplusplus */
 
-/* Start of speedometer bitmap on oled x axis */
-#define SPEEDOMETER_BITMAP_AREA_X 1
-/* Start of speedometer bitmap on oled y axis */
-#define SPEEDOMETER_BITMAP_AREA_Y 1
-
 /* Speedometer bitmap width on oled display */
 #define SPEEDOMETER_BITMAP_AREA_WIDTH 72
 /* Speedometer bitmap height on oled display */
 #define SPEEDOMETER_BITMAP_AREA_HEIGHT 64
 
-/* Start of mph bitmap on oled x axis */
-#define MPH_BITMAP_AREA_X 93
-/* Start of mph bitmap on oled y axis */
-#define MPH_BITMAP_AREA_Y 46
-
 /* Mph bitmap width on oled display */
 #define MPH_BITMAP_AREA_WIDTH 16
 /* Mph bitmap height on oled display */
 #define MPH_BITMAP_AREA_HEIGHT 6
 
-/* Start of speed string on oled x axis */
-#define SPEEDOMETER_STRING_AREA_X 90
-/* Start of speed string on oled y axis */
-#define SPEEDOMETER_STRING_AREA_Y 32
 
-    const uint8_t speedometer_bitmap[] = {
+    static const uint8_t speedometer_bitmap[] = {
         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x08, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x08, 0x20, 0x00, 0x00, 0x00, 0x00,
         0x00, 0x01, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x01, 0x03, 0xff, 0xc0, 0x80, 0x00, 0x00, 0x00, 0x00, 0x20, 0x3c, 0x00, 0x3c, 0x04, 0x00, 0x00, 0x00, 0x00,
         0x21, 0xc0, 0x00, 0x03, 0x84, 0x00, 0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x60, 0x00, 0x00, 0x00, 0x00, 0x18, 0x40, 0x00, 0x02, 0x18, 0x00, 0x00, 0x00, 0x04, 0x20,
@@ -64,7 +53,7 @@ extern "C"
         0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x50, 0x40, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10,
         0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00};
     
-    const uint8_t mph_bitmap[] = {0x8b, 0xd2, 0xda, 0x52, 0xab, 0xde, 0x8a, 0x12, 0x8a, 0x12, 0x8a, 0x12};
+    static const uint8_t mph_bitmap[] = {0x8b, 0xd2, 0xda, 0x52, 0xab, 0xde, 0x8a, 0x12, 0x8a, 0x12, 0x8a, 0x12};
 
 
 #ifdef __cplusplus
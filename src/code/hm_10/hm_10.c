@@ -10,24 +10,60 @@
 
 #include "hm_10.h"
 #include "hm_10_init_commands.h"
+#include "startup.h"
 #include "usart.h"
 #include <string.h>
 
 /* AT Command buf length */
 #define MAX_AT_COMMAND_LEN 32
 
-/* Time between At Commands in ms */
-#define AT_COMMAND_DELAY 1000
+/* Time to wait for previous AT command to be sent in ms */
+#define AT_COMMAND_TX_TIMEOUT 100
+
+/* AT response buf length */
+#define MAX_AT_RESPONSE_LEN 32
+
+/* Response tail kept when buf is full, expected replies must be shorter */
+#define AT_RESPONSE_KEEP 15
+
+/* Time to wait for response while probing baud rate in ms */
+#define AT_PROBE_TIMEOUT 100
+
+/* Number of AT probes at new baud rate while module restarts */
+#define AT_RESET_PROBES 10
 
 /* Buffer to contain AT Commands for HM-10 Initialization */
 static char at_command_buf[MAX_AT_COMMAND_LEN];
 
 /**
- * @brief Initialization task with at commands of hm-10 module
- *
- * @param params Task parameteres - unused.
+ * Baud rate supported by both hm-10 (AT-09 firmware) and USART.
  */
-static void hm_10_at_init_task(void* params);
+struct hm_10_baud
+{
+    uint32_t baud;   /**< Baud rate in bits per second */
+    const char* cmd; /**< AT command selecting this rate */
+};
+
+/* Supported baud rates, fastest first */
+static const struct hm_10_baud hm_10_bauds[] = {
+    {115200, "BAUD8"},
+    {57600, "BAUD7"},
+    {38400, "BAUD6"},
+    {19200, "BAUD5"},
+    {9600, "BAUD4"},
+};
+
+/* Number of supported baud rates */
+#define HM_10_BAUDS_SIZE (sizeof(hm_10_bauds) / sizeof(hm_10_bauds[0]))
+
+/* Baud rate the module answered at, NULL if unknown */
+static const struct hm_10_baud* hm_10_baud;
+
+/* Plain "AT" used to find out if module answers */
+static const struct hm_10_at_command at_command_probe = {NULL, "OK", AT_PROBE_TIMEOUT, 0};
+
+/* Initialization result, written by hm_10_at_init() only */
+static struct hm_10_at_report at_report = {-EINPROGRESS, NULL, 0, 0};
 
 /**
  * @brief Send at command to hm-10 module
@@ -36,15 +72,62 @@ static void hm_10_at_init_task(void* params);
  */
 static int32_t hm_10_send_at_command(const char* command);
 
-void hm_10_task_init(void)
+/**
+ * @brief Wait for module response to AT command
+ *
+ * Response is complete when expected reply or ERROR shows up in RX stream,
+ * so command finishes as soon as module answers.
+ *
+ * @param reply - text of successful response
+ * @param ms - time to wait in ms
+ * @return int32_t - 0 on reply, -EIO on ERROR, -ETIMEDOUT otherwise
+ */
+static int32_t hm_10_wait_response(const char* reply, uint32_t ms);
+
+/**
+ * @brief Send AT command and wait for response, repeat on failure
+ *
+ * @param command - command to execute
+ * @return int32_t - 0 on success, error of last attempt otherwise
+ */
+static int32_t hm_10_at_execute(const struct hm_10_at_command* command);
+
+/**
+ * @brief Execute AT commands in order, stop on first failure
+ *
+ * @param commands - commands to execute
+ * @param len - number of commands
+ * @return int32_t - Error code.
+ */
+static int32_t hm_10_at_execute_all(const struct hm_10_at_command* commands, uint32_t len);
+
+/**
+ * @brief Find module baud rate by sending AT at each supported rate
+ *
+ * @return int32_t - 0 when module answered, -ENODEV otherwise
+ */
+static int32_t hm_10_probe_baud(void);
+
+/**
+ * @brief Switch module and USART to the fastest supported baud rate
+ *
+ * @return int32_t - Error code.
+ */
+static int32_t hm_10_set_max_baud(void);
+
+void hm_10_init(void)
 {
     usart_init();
-
-    rtos_task_create(hm_10_at_init_task, "hm_10_at_init", HM_10_AT_INIT_TASK_STACKSIZE, HM_10_AT_INIT_TASK_PRIORITY, NULL);
 }
 
 static int32_t hm_10_send_at_command(const char* command)
 {
+    /* Buffer is owned by USART driver until previous command is sent */
+    if(usart_tx_wait(AT_COMMAND_TX_TIMEOUT) != 0)
+    {
+        return -EBUSY;
+    }
+
     memset(at_command_buf, 0, MAX_AT_COMMAND_LEN);
     strcpy(at_command_buf, "AT");
 
@@ -61,29 +144,200 @@ static int32_t hm_10_send_at_command(const char* command)
     return hm_10_send_buf((uint8_t*)at_command_buf, len);
 }
 
+static int32_t hm_10_wait_response(const char* reply, uint32_t ms)
+{
+    char response[MAX_AT_RESPONSE_LEN];
+    int32_t len = 0;
+    tick_t start = rtos_tick_count_get();
+    uint32_t elapsed_ms;
+
+    while((elapsed_ms = (rtos_tick_count_get() - start) * portTICK_RATE_MS) < ms)
+    {
+        /* Reply deadline bounds the wait, module may never answer */
+        int32_t n = usart_read_buf((uint8_t*)&response[len], MAX_AT_RESPONSE_LEN - 1 - len, ms - elapsed_ms, NULL);
+
+        if(n <= 0)
+        {
+            continue;
+        }
+
+        len += n;
+        response[len] = '\0';
+
+        /* OK+... and +...=... replies of both firmwares contain reply text */
+        if(strstr(response, reply) != NULL)
+        {
+            return 0;
+        }
+
+        if(strstr(response, "ERROR") != NULL)
+        {
+            return -EIO;
+        }
+
+        if(len == (MAX_AT_RESPONSE_LEN - 1))
+        {
+            /* Keep tail in case reply is split between reads */
+            int32_t keep = AT_RESPONSE_KEEP;
+            memmove(response, &response[len - keep], keep);
+            len = keep;
+        }
+    }
+
+    return -ETIMEDOUT;
+}
+
+static int32_t hm_10_at_execute(const struct hm_10_at_command* command)
+{
+    int32_t ret = -ETIMEDOUT;
+
+    at_report.command = command->cmd;
+
+    for(uint8_t attempt = 0; attempt <= command->retries; attempt++)
+    {
+        at_report.attempts = attempt + 1;
+
+        /* Drop leftovers of previous response */
+        usart_rx_flush();
+
+        ret = hm_10_send_at_command(command->cmd);
+
+        if(ret == 0)
+        {
+            ret = hm_10_wait_response(command->reply, command->timeout);
+        }
+
+        if(ret == 0)
+        {
+            break;
+        }
+    }
+
+    return ret;
+}
+
+static int32_t hm_10_at_execute_all(const struct hm_10_at_command* commands, uint32_t len)
+{
+    for(uint32_t i = 0; i < len; i++)
+    {
+        int32_t ret = hm_10_at_execute(&commands[i]);
+
+        if(ret == -ETIMEDOUT && hm_10_probe_baud() == 0)
+        {
+            /* Module restarted at another baud rate, e.g. after DEFAULT */
+            ret = hm_10_at_execute(&commands[i]);
+        }
+
+        if(ret != 0)
+        {
+            return ret;
+        }
+    }
+
+    return 0;
+}
+
+static int32_t hm_10_probe_baud(void)
+{
+    for(uint8_t i = 0; i < HM_10_BAUDS_SIZE; i++)
+    {
+        usart_set_baud(hm_10_bauds[i].baud);
+
+        if(hm_10_at_execute(&at_command_probe) == 0)
+        {
+            hm_10_baud = &hm_10_bauds[i];
+            return 0;
+        }
+    }
+
+    hm_10_baud = NULL;
+    return -ENODEV;
+}
+
+static int32_t hm_10_set_max_baud(void)
+{
+    const struct hm_10_at_command baud = {hm_10_bauds[0].cmd, "OK", AT_PROBE_TIMEOUT, 2};
+    const struct hm_10_at_command reset = {"RESET", "OK", AT_PROBE_TIMEOUT, 2};
+    const struct hm_10_at_command restart = {NULL, "OK", AT_PROBE_TIMEOUT, AT_RESET_PROBES};
+
+    if(hm_10_baud == &hm_10_bauds[0])
+    {
+        /* Already at the fastest rate */
+        return 0;
+    }
+
+    if(hm_10_at_execute(&baud) != 0 || hm_10_at_execute(&reset) != 0)
+    {
+        return -EIO;
+    }
+
+    /* New rate is used after restart, module answers as soon as it is up */
+    usart_set_baud(hm_10_bauds[0].baud);
+
+    if(hm_10_at_execute(&restart) == 0)
+    {
+        hm_10_baud = &hm_10_bauds[0];
+        return 0;
+    }
+
+    return hm_10_probe_baud();
+}
+
+void hm_10_at_report_get(struct hm_10_at_report* report)
+{
+    rtos_critical_section_enter();
+    *report = at_report;
+    rtos_critical_section_exit();
+}
+
 int32_t hm_10_send_buf(uint8_t* buf, const int32_t len)
 {
     return usart_send_buf(buf, len);
 }
 
-int32_t hm_10_read_buf(uint8_t* buf, const int32_t len)
+int32_t hm_10_tx_wait(const int32_t ms)
 {
-    return usart_read_buf(buf, len);
+    return usart_tx_wait(ms);
 }
 
-static void hm_10_at_init_task(void* params)
+int32_t hm_10_read_buf(uint8_t* buf, const int32_t len, uint32_t* time)
 {
-    (void)params;
-    tick_t tick_cnt;
+    if(!startup_ready_wait(STARTUP_READY_BLE, 0))
+    {
+        return -EBUSY;
+    }
+
+    /* Stream is read without timeout, rx interrupts wake the reader */
+    return usart_read_buf(buf, len, portMAX_DELAY, time);
+}
 
-    for(uint8_t i = 0; i < AT_COMMANDS_INIT_SIZE; i++)
+int32_t hm_10_at_init(void)
+{
+    tick_t start = rtos_tick_count_get();
+    int32_t ret = hm_10_probe_baud();
+
+    if(ret == 0)
     {
-        tick_cnt = rtos_tick_count_get();
-        /* Send AT command init */
-        hm_10_send_at_command(at_commands_init[i]);
+        ret = hm_10_at_execute_all(at_commands_config, AT_COMMANDS_CONFIG_SIZE);
+    }
 
-        rtos_delay_until(&tick_cnt, AT_COMMAND_DELAY);
+    if(ret == 0)
+    {
+        /* DEFAULT may have restored factory baud rate */
+        ret = hm_10_set_max_baud();
+    }
+
+    if(ret == 0)
+    {
+        ret = hm_10_at_execute_all(at_commands_connect, AT_COMMANDS_CONNECT_SIZE);
     }
 
-    vTaskSuspend(NULL);
+    rtos_critical_section_enter();
+    at_report.time_ms = (rtos_tick_count_get() - start) * portTICK_RATE_MS;
+    at_report.status = ret;
+    rtos_critical_section_exit();
+
+    startup_ready_set(STARTUP_READY_BLE);
+
+    return ret;
 }
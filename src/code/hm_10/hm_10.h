@@ -20,6 +20,8 @@ extern "C"
     /**
      * Send buffer through hm-10.
      *
+     * Buffer is sent by DMA, see usart_send_buf() for ownership rules.
+     *
      * @param buf           Buffer to send.
      * @param len           Length of buffer.
      *
@@ -27,21 +29,63 @@ extern "C"
      */
     int32_t hm_10_send_buf(uint8_t* buf, const int32_t len);
 
+    /**
+     * Wait until buffer passed to hm_10_send_buf() is sent.
+     *
+     * @param ms            Time to wait in ms.
+     *
+     * @return              0 when buffer is back to the caller, -EBUSY on timeout.
+     */
+    int32_t hm_10_tx_wait(const int32_t ms);
+
     /**
      * Read buffer through hm-10.
      *
+     * Module responses belong to initialization, so nothing is read before
+     * it finishes. Afterwards blocks until data is received.
+     *
      * @param buf           Buffer to read.
      * @param len           Length of buffer.
+     * @param time          Value of latency_stats_time_get() at reception of read bytes, may be NULL.
      *
-     * @return              Error code.
+     * @return              Number of bytes read or error code, -EBUSY during initialization,
+     *                      -EOVERFLOW when received bytes were lost.
+     */
+    int32_t hm_10_read_buf(uint8_t* buf, const int32_t len, uint32_t* time);
+
+    /**
+     * Result of hm-10 initialization with AT commands.
+     */
+    struct hm_10_at_report
+    {
+        int32_t status;      /**< 0 when done, -EINPROGRESS while running, error code of failed command otherwise */
+        const char* command; /**< Last command sent, NULL for plain "AT" */
+        uint8_t attempts;    /**< Attempts used by last command */
+        uint32_t time_ms;    /**< Time spent on initialization in ms */
+    };
+
+    /**
+     * Get result of hm-10 initialization.
+     *
+     * @param report        Report to fill.
      */
-    int32_t hm_10_read_buf(uint8_t* buf, const int32_t len);
+    void hm_10_at_report_get(struct hm_10_at_report* report);
 
     /**
-     * @brief Initialize hm-10 to work
+     * @brief Initialize USART used by hm-10
+     *
+     */
+    void hm_10_init(void);
+
+    /**
+     * Configure module with AT commands.
+     *
+     * Blocks until done, called once by the task which reads the link
+     * afterwards. Sets STARTUP_READY_BLE also on failure.
      *
+     * @return              Error code, also in hm_10_at_report_get().
      */
-    void hm_10_task_init(void);
+    int32_t hm_10_at_init(void);
 
 #ifdef __cplusplus
 }
@@ -10,6 +10,8 @@
 #ifndef _HM_10_INIT_COMMANDS_H_
 #define _HM_10_INIT_COMMANDS_H_
 
+#include "platform_specific.h"
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -17,16 +19,34 @@ extern "C"
 
     /* compatible with at-09 standard */
 
-#define AT_COMMANDS_INIT_SIZE (sizeof(at_commands_init) / sizeof(at_commands_init[0]))
+    /**
+     * AT command sent during hm-10 initialization.
+     */
+    struct hm_10_at_command
+    {
+        const char* cmd;   /**< Command after "AT+", NULL for plain "AT" */
+        const char* reply; /**< Text of successful response, "OK" for most commands */
+        uint16_t timeout;  /**< Time to wait for response in ms */
+        uint8_t retries;   /**< Number of repeats after ERROR or timeout */
+    };
+
+#define AT_COMMANDS_CONFIG_SIZE (sizeof(at_commands_config) / sizeof(at_commands_config[0]))
+#define AT_COMMANDS_CONNECT_SIZE (sizeof(at_commands_connect) / sizeof(at_commands_connect[0]))
+
+    /* if you want to change hm-10 module settings , edit only these arrays */
+
+    /* Sent first, baud rate is raised after them as DEFAULT restores factory rate */
+    static const struct hm_10_at_command at_commands_config[] = {
+        {"DEFAULT", "OK", 1000, 2},       /* Set defualt settings, module restarts */
+        {"NAMECONTROLLER", "OK", 300, 2}, /* Name = CONTROLLER */
+        {"ROLE1", "OK", 300, 2},          /* Role = MASTER */
+        {"IMME0", "OK", 300, 2},          /* Transparent mode */
+    };
 
-    /* if you want to change hm-10 module settings , edit only this array */
-    const char* at_commands_init[] = {
-        "DEFAULT",        /* Set defualt settings */
-        "NAMECONTROLLER", /* Name = CONTROLLER */
-        "ROLE1",          /* Role = MASTER */
-        "IMME0",          /* Transparent mode */
-        "INQ",            /* Searching a device to connect */
-        "CONADDR_MAC"     /* Set MAC Adress of other hm-10 or bluetooth device */
+    /* Sent at the final baud rate, module stops answering AT commands when connected */
+    static const struct hm_10_at_command at_commands_connect[] = {
+        {"INQ", "+INQE", 5000, 1},      /* Searching a device to connect, ends with +INQE */
+        {"CONADDR_MAC", "OK", 3000, 2}, /* Set MAC Adress of other hm-10 or bluetooth device */
     };
 
 #ifdef __cplusplus
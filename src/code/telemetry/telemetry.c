@@ -0,0 +1,295 @@
+/**
+ * @file telemetry.c
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Framed binary telemetry protocol used over hm-10 link
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "telemetry.h"
+#include <string.h>
+
+/* Initial value of CRC-16/CCITT-FALSE */
+#define TELEMETRY_CRC_INIT 0xFFFF
+
+/* Longest COBS block code, block without implicit zero */
+#define COBS_CODE_MAX 0xFF
+
+/* CRC-16/CCITT-FALSE (poly 0x1021) of single nibble, 4 bits per step keeps table small */
+static const uint16_t crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7, 0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+/**
+ * @brief Update CRC-16/CCITT-FALSE with bytes
+ *
+ * @param crc - CRC of previous bytes
+ * @param buf - bytes
+ * @param len - number of bytes
+ * @return uint16_t - updated CRC
+ */
+static uint16_t telemetry_crc16(uint16_t crc, const uint8_t* buf, uint32_t len);
+
+/**
+ * @brief Check decoded bytes of frame ended with delimiter
+ *
+ * @param dec - decoder
+ * @param frame - decoded frame
+ * @return int32_t - 1 when frame is valid, 0 on empty frame, -EBADMSG otherwise
+ */
+static int32_t telemetry_decoder_finish(struct telemetry_decoder* dec, struct telemetry_frame* frame);
+
+/**
+ * @brief Append decoded byte to current frame
+ *
+ * @param dec - decoder
+ * @param byte - decoded byte
+ */
+static void telemetry_decoder_put(struct telemetry_decoder* dec, uint8_t byte);
+
+static uint16_t telemetry_crc16(uint16_t crc, const uint8_t* buf, uint32_t len)
+{
+    for(uint32_t i = 0; i < len; i++)
+    {
+        crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (buf[i] >> 4)];
+        crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (buf[i] & 0x0F)];
+    }
+
+    return crc;
+}
+
+int32_t telemetry_encode(const struct telemetry_frame* frame, uint8_t* buf, uint32_t size)
+{
+    uint8_t raw[TELEMETRY_PAYLOAD_MAX + TELEMETRY_FRAME_OVERHEAD];
+    uint32_t raw_len = frame->len + TELEMETRY_FRAME_OVERHEAD;
+
+    if(frame->len > TELEMETRY_PAYLOAD_MAX || size < (raw_len + 2))
+    {
+        return -EINVAL;
+    }
+
+    raw[0] = frame->type;
+    raw[1] = frame->seq;
+    memcpy(&raw[2], frame->payload, frame->len);
+
+    uint16_t crc = telemetry_crc16(TELEMETRY_CRC_INIT, raw, raw_len - 2);
+    raw[raw_len - 2] = crc & 0xFF;
+    raw[raw_len - 1] = crc >> 8;
+
+    /* COBS, every zero is replaced by distance to the next one */
+    uint32_t code_index = 0;
+    uint32_t out = 1;
+    uint8_t code = 1;
+
+    for(uint32_t i = 0; i < raw_len; i++)
+    {
+        if(raw[i] == 0)
+        {
+            buf[code_index] = code;
+            code_index = out++;
+            code = 1;
+            continue;
+        }
+
+        buf[out++] = raw[i];
+        code++;
+
+        if(code == COBS_CODE_MAX)
+        {
+            buf[code_index] = code;
+            code_index = out++;
+            code = 1;
+        }
+    }
+
+    buf[code_index] = code;
+    buf[out++] = TELEMETRY_DELIMITER;
+
+    return out;
+}
+
+void telemetry_decoder_init(struct telemetry_decoder* dec)
+{
+    memset(dec, 0, sizeof(*dec));
+}
+
+void telemetry_decoder_resync(struct telemetry_decoder* dec)
+{
+    /* Frame is open and broken, so the delimiter ends it with an error */
+    dec->len = 0;
+    dec->code = COBS_CODE_MAX;
+    dec->remaining = 0;
+    dec->overflow = true;
+}
+
+static void telemetry_decoder_put(struct telemetry_decoder* dec, uint8_t byte)
+{
+    if(dec->len == sizeof(dec->buf))
+    {
+        dec->overflow = true;
+        return;
+    }
+
+    dec->buf[dec->len++] = byte;
+}
+
+static int32_t telemetry_decoder_finish(struct telemetry_decoder* dec, struct telemetry_frame* frame)
+{
+    if(dec->code == 0)
+    {
+        /* Back to back delimiters */
+        return 0;
+    }
+
+    if(dec->overflow || dec->remaining != 0 || dec->len < TELEMETRY_FRAME_OVERHEAD)
+    {
+        dec->errors++;
+        return -EBADMSG;
+    }
+
+    uint8_t len = dec->len - 2;
+    uint16_t crc = dec->buf[len] | (dec->buf[len + 1] << 8);
+
+    if(telemetry_crc16(TELEMETRY_CRC_INIT, dec->buf, len) != crc)
+    {
+        dec->errors++;
+        return -EBADMSG;
+    }
+
+    frame->type = dec->buf[0];
+    frame->seq = dec->buf[1];
+    frame->len = len - 2;
+    memcpy(frame->payload, &dec->buf[2], frame->len);
+
+    if(dec->synced)
+    {
+        dec->lost += (uint8_t)(frame->seq - dec->seq - 1);
+    }
+
+    dec->seq = frame->seq;
+    dec->synced = true;
+    dec->frames++;
+
+    return 1;
+}
+
+int32_t telemetry_decode(struct telemetry_decoder* dec, const uint8_t* buf, uint32_t len, struct telemetry_frame* frame, uint32_t* used)
+{
+    for(uint32_t i = 0; i < len; i++)
+    {
+        uint8_t byte = buf[i];
+
+        if(byte == TELEMETRY_DELIMITER)
+        {
+            int32_t ret = telemetry_decoder_finish(dec, frame);
+
+            dec->len = 0;
+            dec->code = 0;
+            dec->remaining = 0;
+            dec->overflow = false;
+
+            if(ret != 0)
+            {
+                *used = i + 1;
+                return ret;
+            }
+
+            continue;
+        }
+
+        if(dec->remaining == 0)
+        {
+            /* Block shorter than max is followed by zero, except the last one */
+            if(dec->code != 0 && dec->code != COBS_CODE_MAX)
+            {
+                telemetry_decoder_put(dec, 0);
+            }
+
+            dec->code = byte;
+            dec->remaining = byte - 1;
+            continue;
+        }
+
+        telemetry_decoder_put(dec, byte);
+        dec->remaining--;
+    }
+
+    *used = len;
+    return 0;
+}
+
+void telemetry_state_pack(struct telemetry_frame* frame, const struct telemetry_state* state)
+{
+    frame->type = TELEMETRY_TYPE_STATE;
+    frame->len = TELEMETRY_STATE_LEN;
+    frame->payload[0] = state->speed & 0xFF;
+    frame->payload[1] = state->speed >> 8;
+    frame->payload[2] = state->battery_mv & 0xFF;
+    frame->payload[3] = state->battery_mv >> 8;
+    frame->payload[4] = state->status;
+}
+
+int32_t telemetry_state_unpack(const struct telemetry_frame* frame, struct telemetry_state* state)
+{
+    if(frame->type != TELEMETRY_TYPE_STATE || frame->len < TELEMETRY_STATE_LEN)
+    {
+        return -EBADMSG;
+    }
+
+    /* Longer payload is accepted, fields added later are appended */
+    state->speed = frame->payload[0] | (frame->payload[1] << 8);
+    state->battery_mv = frame->payload[2] | (frame->payload[3] << 8);
+    state->status = frame->payload[4];
+
+    return 0;
+}
+
+void telemetry_cpu_stats_pack(struct telemetry_frame* frame, const struct cpu_stats_report* report)
+{
+    frame->type = TELEMETRY_TYPE_CPU_STATS;
+    frame->len = TELEMETRY_CPU_STATS_LEN;
+    frame->payload[0] = report->window_ms & 0xFF;
+    frame->payload[1] = (report->window_ms >> 8) & 0xFF;
+    frame->payload[2] = (report->window_ms >> 16) & 0xFF;
+    frame->payload[3] = report->window_ms >> 24;
+    frame->payload[4] = report->n_tasks;
+    frame->payload[5] = CPU_STATS_ISR_COUNT;
+
+    for(uint32_t i = 0; i < CPU_STATS_ISR_COUNT; i++)
+    {
+        frame->payload[6 + 2 * i] = report->isr_permille[i] & 0xFF;
+        frame->payload[7 + 2 * i] = report->isr_permille[i] >> 8;
+    }
+}
+
+void telemetry_cpu_task_pack(struct telemetry_frame* frame, const struct cpu_stats_task* task)
+{
+    uint32_t name_len = strnlen(task->name, sizeof(task->name));
+
+    frame->type = TELEMETRY_TYPE_CPU_TASK;
+    frame->len = TELEMETRY_CPU_TASK_HEADER_LEN + name_len;
+    frame->payload[0] = task->number;
+    frame->payload[1] = task->priority;
+    frame->payload[2] = task->permille & 0xFF;
+    frame->payload[3] = task->permille >> 8;
+    frame->payload[4] = task->stack_free & 0xFF;
+    frame->payload[5] = task->stack_free >> 8;
+    memcpy(&frame->payload[TELEMETRY_CPU_TASK_HEADER_LEN], task->name, name_len);
+}
+
+void telemetry_latency_pack(struct telemetry_frame* frame, const struct latency_stats_report* report)
+{
+    const uint32_t values[] = {report->count, report->min_us, report->p50_us, report->p99_us, report->max_us};
+
+    frame->type = TELEMETRY_TYPE_LATENCY;
+    frame->len = TELEMETRY_LATENCY_LEN;
+
+    for(uint32_t i = 0; i < TELEMETRY_LATENCY_LEN / 4; i++)
+    {
+        frame->payload[4 * i] = values[i] & 0xFF;
+        frame->payload[4 * i + 1] = (values[i] >> 8) & 0xFF;
+        frame->payload[4 * i + 2] = (values[i] >> 16) & 0xFF;
+        frame->payload[4 * i + 3] = values[i] >> 24;
+    }
+}
@@ -0,0 +1,213 @@
+/**
+ * @file telemetry.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Framed binary telemetry protocol used over hm-10 link
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+#include "cpu_stats.h"
+#include "latency_stats.h"
+#include "platform_specific.h"
+
+/**
+ * @defgroup code_telemetry
+ *
+ * Frame before encoding is | type | seq | payload | crc16 (lsb first) |,
+ * CRC-16/CCITT-FALSE is computed over type, seq and payload. Frame is
+ * COBS encoded and ended with 0x00, which never shows up inside encoded
+ * data, so decoder resynchronizes on the next delimiter after any lost
+ * or extra byte. Multi byte fields are sent lsb first.
+ *
+ * @{
+ */
+
+/* Max payload length in bytes */
+#define TELEMETRY_PAYLOAD_MAX 32
+
+/* Type, seq and crc bytes added to payload */
+#define TELEMETRY_FRAME_OVERHEAD 4
+
+/* Max length of encoded frame with COBS overhead and delimiter */
+#define TELEMETRY_ENCODED_MAX (TELEMETRY_PAYLOAD_MAX + TELEMETRY_FRAME_OVERHEAD + 2)
+
+/* Frame delimiter */
+#define TELEMETRY_DELIMITER 0x00
+
+/**
+ * Frame types.
+ */
+enum telemetry_type
+{
+    TELEMETRY_TYPE_STATE = 0x01,             /**< Payload is struct telemetry_state */
+    TELEMETRY_TYPE_CPU_STATS_REQUEST = 0x02, /**< Empty payload, answered with CPU usage report and TELEMETRY_TYPE_LATENCY */
+    TELEMETRY_TYPE_CPU_STATS = 0x03,         /**< Report header, followed by one TELEMETRY_TYPE_CPU_TASK per task */
+    TELEMETRY_TYPE_CPU_TASK = 0x04,          /**< CPU usage of single task */
+    TELEMETRY_TYPE_LATENCY = 0x05,           /**< Telemetry to pixel latency since previous report */
+};
+
+/* Status flags of struct telemetry_state */
+#define TELEMETRY_STATUS_CHARGING (1 << 0)
+#define TELEMETRY_STATUS_BATTERY_LOW (1 << 1)
+#define TELEMETRY_STATUS_FAULT (1 << 2)
+
+/**
+ * Decoded frame.
+ */
+struct telemetry_frame
+{
+    uint8_t type;                           /**< Frame type, enum telemetry_type */
+    uint8_t seq;                            /**< Sequence number, incremented by sender */
+    uint8_t len;                            /**< Payload length */
+    uint8_t payload[TELEMETRY_PAYLOAD_MAX]; /**< Payload */
+};
+
+/**
+ * Values sent together in TELEMETRY_TYPE_STATE frame.
+ */
+struct telemetry_state
+{
+    uint16_t speed;      /**< Speed in mph */
+    uint16_t battery_mv; /**< Battery voltage in mV */
+    uint8_t status;      /**< TELEMETRY_STATUS_ flags */
+};
+
+/* Payload length of TELEMETRY_TYPE_STATE frame */
+#define TELEMETRY_STATE_LEN 5
+
+/*
+ * TELEMETRY_TYPE_CPU_STATS payload:
+ * | window_ms u32 | n_tasks u8 | n_isrs u8 | permille u16 of each enum cpu_stats_isr |
+ */
+#define TELEMETRY_CPU_STATS_LEN (6 + 2 * CPU_STATS_ISR_COUNT)
+
+/*
+ * TELEMETRY_TYPE_CPU_TASK payload:
+ * | number u8 | priority u8 | permille u16 | stack_free u16 | name without terminator |
+ */
+#define TELEMETRY_CPU_TASK_HEADER_LEN 6
+
+/*
+ * TELEMETRY_TYPE_LATENCY payload:
+ * | count u32 | min_us u32 | p50_us u32 | p99_us u32 | max_us u32 |
+ */
+#define TELEMETRY_LATENCY_LEN 20
+
+/**
+ * Incremental decoder state.
+ */
+struct telemetry_decoder
+{
+    uint8_t buf[TELEMETRY_PAYLOAD_MAX + TELEMETRY_FRAME_OVERHEAD]; /**< Decoded bytes of current frame */
+    uint8_t len;                                                   /**< Number of decoded bytes */
+    uint8_t code;                                                  /**< Current COBS block code */
+    uint8_t remaining;                                             /**< Bytes left in current COBS block */
+    bool overflow;                                                 /**< Frame too long, dropped at delimiter */
+    bool synced;                                                   /**< Previous frame seq is known */
+    uint8_t seq;                                                   /**< Sequence number of previous frame */
+    uint32_t frames;                                               /**< Number of valid frames */
+    uint32_t errors;                                               /**< Number of dropped frames */
+    uint32_t lost;                                                 /**< Number of frames missing in sequence */
+};
+
+/**
+ * @brief Encode frame
+ *
+ * @param frame - frame to encode
+ * @param buf - output buffer, TELEMETRY_ENCODED_MAX is always enough
+ * @param size - output buffer size
+ * @return int32_t - encoded length with delimiter, -EINVAL if frame or buffer is too long
+ */
+int32_t telemetry_encode(const struct telemetry_frame* frame, uint8_t* buf, uint32_t size);
+
+/**
+ * @brief Reset decoder, next frame starts after delimiter
+ *
+ * @param dec - decoder
+ */
+void telemetry_decoder_init(struct telemetry_decoder* dec);
+
+/**
+ * @brief Drop frame in progress after bytes were lost, e.g. by rx overrun
+ *
+ * Bytes up to the next delimiter are counted as one broken frame, counters
+ * and sequence number are kept.
+ *
+ * @param dec - decoder
+ */
+void telemetry_decoder_resync(struct telemetry_decoder* dec);
+
+/**
+ * @brief Feed decoder with received bytes
+ *
+ * Stops after first complete frame, remaining bytes are fed again by caller.
+ *
+ * @param dec - decoder
+ * @param buf - received bytes
+ * @param len - number of bytes
+ * @param frame - decoded frame
+ * @param used - number of bytes consumed
+ * @return int32_t - 1 when frame is decoded, 0 when more bytes are needed,
+ *                   -EBADMSG on broken frame
+ */
+int32_t telemetry_decode(struct telemetry_decoder* dec, const uint8_t* buf, uint32_t len, struct telemetry_frame* frame, uint32_t* used);
+
+/**
+ * @brief Put state into TELEMETRY_TYPE_STATE frame
+ *
+ * @param frame - frame, seq is left unchanged
+ * @param state - values to send
+ */
+void telemetry_state_pack(struct telemetry_frame* frame, const struct telemetry_state* state);
+
+/**
+ * @brief Get state from TELEMETRY_TYPE_STATE frame
+ *
+ * @param frame - decoded frame
+ * @param state - received values
+ * @return int32_t - 0 on success, -EBADMSG if frame isn't valid state frame
+ */
+int32_t telemetry_state_unpack(const struct telemetry_frame* frame, struct telemetry_state* state);
+
+/**
+ * @brief Put header of CPU usage report into TELEMETRY_TYPE_CPU_STATS frame
+ *
+ * @param frame - frame, seq is left unchanged
+ * @param report - CPU usage report
+ */
+void telemetry_cpu_stats_pack(struct telemetry_frame* frame, const struct cpu_stats_report* report);
+
+/**
+ * @brief Put CPU usage of task into TELEMETRY_TYPE_CPU_TASK frame
+ *
+ * @param frame - frame, seq is left unchanged
+ * @param task - CPU usage of task
+ */
+void telemetry_cpu_task_pack(struct telemetry_frame* frame, const struct cpu_stats_task* task);
+
+/**
+ * @brief Put latency summary into TELEMETRY_TYPE_LATENCY frame
+ *
+ * @param frame - frame, seq is left unchanged
+ * @param report - latency summary
+ */
+void telemetry_latency_pack(struct telemetry_frame* frame, const struct latency_stats_report* report);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _TELEMETRY_H_ */
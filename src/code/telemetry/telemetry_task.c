@@ -0,0 +1,250 @@
+/**
+ * @file telemetry_task.c
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Telemetry receiver task owning hm-10 RX stream
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "telemetry_task.h"
+#include "hm_10.h"
+#include <string.h>
+
+/* Time to wait for previous report to be sent in ms */
+#define TELEMETRY_TX_TIMEOUT 50
+
+/* Encoded statistics, CPU usage header, task and latency frames, owned by USART until sent */
+static uint8_t stats_buf[(2 + CPU_STATS_MAX_TASKS) * TELEMETRY_ENCODED_MAX];
+
+/* Snapshot is published with seqlock, odd sequence means write in progress */
+static struct telemetry_snapshot published;
+static uint32_t published_seq;
+
+/* Memory of receiver task, used by hm-10 initialization first */
+static task_stack_t telemetry_stack[TELEMETRY_STACKSIZE];
+static task_buf_t telemetry_task_buf;
+
+/* Task notified about changed values, NULL if none */
+static void* volatile notify_task;
+static volatile uint32_t notify_bits;
+
+/**
+ * @brief Telemetry receiver task handler
+ *
+ * @param params Task parameters - unused.
+ */
+static void telemetry_task(void* params);
+
+/**
+ * @brief Publish snapshot for readers
+ *
+ * Called only by receiver task.
+ *
+ * @param update - new snapshot
+ */
+static void telemetry_snapshot_publish(const struct telemetry_snapshot* update);
+
+/**
+ * @brief Check if received values differ, frames repeating them don't notify
+ *
+ * @param a - first state
+ * @param b - second state
+ * @return bool - true when speed, battery or status differ
+ */
+static bool telemetry_state_changed(const struct telemetry_state* a, const struct telemetry_state* b);
+
+/**
+ * @brief Encode frame at the end of statistics buffer
+ *
+ * Frame which doesn't fit is skipped, its sequence number is not used.
+ *
+ * @param frame - frame to encode, seq is set here
+ * @param seq - sequence number of the next sent frame
+ * @param len - length of already encoded frames
+ * @return uint32_t - length of encoded frames with this one
+ */
+static uint32_t telemetry_stats_append(struct telemetry_frame* frame, uint8_t* seq, uint32_t len);
+
+/**
+ * @brief Send CPU usage and latency since previous report
+ *
+ * @param seq - sequence number of the next sent frame
+ */
+static void telemetry_stats_send(uint8_t* seq);
+
+void telemetry_task_init(void)
+{
+    /* Priority is lowered after hm-10 initialization */
+    rtos_task_create_static(telemetry_task, "telemetry", TELEMETRY_STACKSIZE, HM_10_AT_INIT_PRIORITY, telemetry_stack, &telemetry_task_buf);
+}
+
+void telemetry_set_notify(void* task, uint32_t bits)
+{
+    notify_bits = bits;
+    notify_task = task;
+}
+
+void telemetry_snapshot_get(struct telemetry_snapshot* snapshot)
+{
+    uint32_t seq;
+
+    do
+    {
+        seq = __atomic_load_n(&published_seq, __ATOMIC_ACQUIRE);
+
+        memcpy(snapshot, &published, sizeof(*snapshot));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        /* Receiver has higher priority, so odd sequence is never seen and copy is retried only if receiver published meanwhile */
+    } while((seq & 1) || seq != __atomic_load_n(&published_seq, __ATOMIC_RELAXED));
+}
+
+static void telemetry_snapshot_publish(const struct telemetry_snapshot* update)
+{
+    uint32_t seq = published_seq;
+
+    __atomic_store_n(&published_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(&published, update, sizeof(published));
+
+    __atomic_store_n(&published_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static bool telemetry_state_changed(const struct telemetry_state* a, const struct telemetry_state* b)
+{
+    return (a->speed != b->speed) || (a->battery_mv != b->battery_mv) || (a->status != b->status);
+}
+
+static void telemetry_stats_send(uint8_t* seq)
+{
+    static struct cpu_stats_report report;
+    struct latency_stats_report latency;
+    struct telemetry_frame frame;
+
+    /* Request repeated before previous report was sent is dropped */
+    if(hm_10_tx_wait(TELEMETRY_TX_TIMEOUT) != 0 || cpu_stats_report_get(&report) != 0)
+    {
+        return;
+    }
+
+    telemetry_cpu_stats_pack(&frame, &report);
+    uint32_t len = telemetry_stats_append(&frame, seq, 0);
+
+    for(uint32_t i = 0; i < report.n_tasks; i++)
+    {
+        telemetry_cpu_task_pack(&frame, &report.tasks[i]);
+        len = telemetry_stats_append(&frame, seq, len);
+    }
+
+    latency_stats_report_get(&latency);
+    telemetry_latency_pack(&frame, &latency);
+    len = telemetry_stats_append(&frame, seq, len);
+
+    if(len > 0)
+    {
+        hm_10_send_buf(stats_buf, len);
+    }
+}
+
+static uint32_t telemetry_stats_append(struct telemetry_frame* frame, uint8_t* seq, uint32_t len)
+{
+    frame->seq = *seq;
+
+    int32_t ret = telemetry_encode(frame, &stats_buf[len], sizeof(stats_buf) - len);
+
+    if(ret < 0)
+    {
+        /* Frame too long or no space left, the rest of report is still sent */
+        return len;
+    }
+
+    (*seq)++;
+
+    return len + ret;
+}
+
+static void telemetry_task(void* params)
+{
+    (void)params;
+
+    static struct telemetry_decoder dec;
+    struct telemetry_snapshot update = {0};
+    struct telemetry_state notified = {0};
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+    uint8_t tx_seq = 0;
+
+    telemetry_decoder_init(&dec);
+
+    /* Module responses belong to hm-10 initialization, link is read even if it failed */
+    hm_10_at_init();
+    rtos_task_priority_set(NULL, TELEMETRY_PRIORITY);
+
+    while(1)
+    {
+        /* Blocks until frame end or rx notify threshold, no timeout */
+        uint32_t rx_time;
+        int32_t len = hm_10_read_buf(buf, sizeof(buf), &rx_time);
+        bool changed = false;
+        bool stats_requested = false;
+
+        if(len == -EOVERFLOW)
+        {
+            /* Unread bytes were overwritten, frame in progress lost its part */
+            telemetry_decoder_resync(&dec);
+        }
+
+        for(uint32_t pos = 0; len > 0 && pos < (uint32_t)len;)
+        {
+            struct telemetry_frame frame;
+            struct telemetry_state state;
+            uint32_t used;
+
+            if(telemetry_decode(&dec, &buf[pos], len - pos, &frame, &used) == 1)
+            {
+                if(telemetry_state_unpack(&frame, &state) == 0)
+                {
+                    /* Latency is measured from the frame which changed speed, the only value shown */
+                    if(state.speed != update.state.speed)
+                    {
+                        update.speed_changed_time = rx_time;
+                    }
+
+                    update.state = state;
+                    update.updated = rtos_tick_count_get();
+                    changed = true;
+                }
+                else if(frame.type == TELEMETRY_TYPE_CPU_STATS_REQUEST)
+                {
+                    stats_requested = true;
+                }
+            }
+
+            pos += used;
+        }
+
+        if(stats_requested)
+        {
+            telemetry_stats_send(&tx_seq);
+        }
+
+        if(changed || dec.errors != update.errors)
+        {
+            update.frames = dec.frames;
+            update.errors = dec.errors;
+            update.lost = dec.lost;
+
+            telemetry_snapshot_publish(&update);
+        }
+
+        void* task = notify_task;
+
+        if((task != NULL) && telemetry_state_changed(&notified, &update.state))
+        {
+            notified = update.state;
+            rtos_task_notify_bits(task, notify_bits);
+        }
+    }
+}
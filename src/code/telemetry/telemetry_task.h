@@ -0,0 +1,65 @@
+/**
+ * @file telemetry_task.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Telemetry receiver task owning hm-10 RX stream
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _TELEMETRY_TASK_H_
+#define _TELEMETRY_TASK_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+#include "platform_specific.h"
+#include "telemetry.h"
+
+    /**
+     * Latest telemetry published by receiver task.
+     */
+    struct telemetry_snapshot
+    {
+        struct telemetry_state state; /**< Latest received values */
+        tick_t updated;               /**< Tick count of latest valid frame, 0 if none */
+        uint32_t speed_changed_time;  /**< latency_stats_time_get() at reception of frame changing speed, 0 if none */
+        uint32_t frames;              /**< Number of valid frames */
+        uint32_t errors;              /**< Number of broken frames */
+        uint32_t lost;                /**< Number of frames missing in sequence */
+    };
+
+    /**
+     * @brief Create telemetry receiver task
+     *
+     * Task is the only reader of hm-10 RX stream, it runs hm-10 AT
+     * initialization first.
+     */
+    void telemetry_task_init(void);
+
+    /**
+     * @brief Set task notified when received values change
+     *
+     * Frames repeating the same values don't notify.
+     *
+     * @param task - task handle, NULL disables notification
+     * @param bits - bits set in task notification value
+     */
+    void telemetry_set_notify(void* task, uint32_t bits);
+
+    /**
+     * @brief Get latest telemetry
+     *
+     * Never blocks, snapshot is copied again if receiver updated it meanwhile.
+     *
+     * @param snapshot - copy of latest telemetry
+     */
+    void telemetry_snapshot_get(struct telemetry_snapshot* snapshot);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _TELEMETRY_TASK_H_ */
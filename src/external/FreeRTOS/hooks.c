@@ -7,16 +7,17 @@
 #include "timers.h"
 #include "semphr.h"
 
-void vApplicationMallocFailedHook(void)
+void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer, StackType_t **ppxIdleTaskStackBuffer, uint32_t *pulIdleTaskStackSize)
 {
-	/* Called if a call to pvPortMalloc() fails because there is insufficient
-	 free memory available in the FreeRTOS heap.  pvPortMalloc() is called
-	 internally by FreeRTOS API functions that create tasks, queues, software
-	 timers, and semaphores.  The size of the FreeRTOS heap is set by the
-	 configTOTAL_HEAP_SIZE configuration constant in FreeRTOSConfig.h. */
+	/* Idle task is created by scheduler, configSUPPORT_STATIC_ALLOCATION
+	 requires the application to provide its memory.  Stack size is the same
+	 as used by the kernel with dynamic allocation. */
+	static StaticTask_t idle_task_buf;
+	static StackType_t idle_stack[configMINIMAL_STACK_SIZE];
 
-	while (1)
-		;
+	*ppxIdleTaskTCBBuffer = &idle_task_buf;
+	*ppxIdleTaskStackBuffer = idle_stack;
+	*pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
 }
 
 void vApplicationStackOverflowHook(xTaskHandle pxTask, signed char *pcTaskName)
@@ -30,9 +31,3 @@ void vApplicationStackOverflowHook(xTaskHandle pxTask, signed char *pcTaskName)
 	while (1)
 		;
 }
-
-void vApplicationIdleHook(void)
-{
-	__attribute__((unused))	volatile size_t rtos_heap_left;
-	rtos_heap_left = xPortGetFreeHeapSize();
-}
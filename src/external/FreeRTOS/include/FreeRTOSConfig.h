@@ -90,25 +90,33 @@
 #endif
 
 #define configUSE_PREEMPTION			1
-#define configUSE_IDLE_HOOK				1
+#define configUSE_IDLE_HOOK				0
 #define configUSE_TICK_HOOK				0
+#define configUSE_TICKLESS_IDLE			2	/* vPortSuppressTicksAndSleep() in low_power.c */
 #define configCPU_CLOCK_HZ				( 84000000UL )
 #define configTICK_RATE_HZ				( ( TickType_t ) 1000 )
 #define configMAX_PRIORITIES			( 10 )
 #define configMINIMAL_STACK_SIZE		( ( unsigned short ) 64 )
-#define configTOTAL_HEAP_SIZE			( ( size_t ) ( 16 * 1024 ) )
-#define configMAX_TASK_NAME_LEN			( 8 )
-#define configUSE_TRACE_FACILITY		0
+#define configSUPPORT_STATIC_ALLOCATION	1	/* Tasks and objects are reserved at link time */
+#define configSUPPORT_DYNAMIC_ALLOCATION	0	/* No heap, heap_4.c isn't built */
+#define configMAX_TASK_NAME_LEN			( 16 )
+#define configUSE_TRACE_FACILITY		1
 #define configUSE_16_BIT_TICKS			0
 #define configIDLE_SHOULD_YIELD			1
 #define configUSE_MUTEXES				1
 #define configQUEUE_REGISTRY_SIZE		8
 #define configCHECK_FOR_STACK_OVERFLOW	2
 #define configUSE_RECURSIVE_MUTEXES		0
-#define configUSE_MALLOC_FAILED_HOOK	1
+#define configUSE_MALLOC_FAILED_HOOK	0
 #define configUSE_APPLICATION_TASK_TAG	0
 #define configUSE_COUNTING_SEMAPHORES	1
-#define configGENERATE_RUN_TIME_STATS	0
+#define configGENERATE_RUN_TIME_STATS	1
+
+/* Run time stats clocked by DWT cycle counter, see cpu_stats.h. */
+void cpu_stats_timer_init( void );
+uint32_t cpu_stats_time_get( void );
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()	cpu_stats_timer_init()
+#define portGET_RUN_TIME_COUNTER_VALUE()			cpu_stats_time_get()
 
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES 		0
@@ -129,6 +137,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskSuspend			1
 #define INCLUDE_vTaskDelayUntil			1
 #define INCLUDE_vTaskDelay				1
+#define INCLUDE_xTaskGetCurrentTaskHandle	1
 
 /* Cortex-M specific definitions. */
 #ifdef __NVIC_PRIO_BITS
@@ -165,5 +174,8 @@ standard names. */
 #define xPortPendSVHandler PendSV_Handler
 #define xPortSysTickHandler SysTick_Handler
 
+/* Trace hooks recording events into RAM ring, see trace.h. */
+#include "trace.h"
+
 #endif /* FREERTOS_CONFIG_H */
 
@@ -8,8 +8,8 @@
  */
 
 #include "ssd1306.h"
-#include "font_ascii_5x7.h"
 #include "i2c_master.h"
+#include "ssd1306_fonts.h"
 #include <string.h>
 
 /* I2C adress of ssd1306 display */
@@ -26,177 +26,747 @@
 /* Special char to send before data */
 #define SSD1306_DATA 0x40
 
+/* SSD1306 number of pages, each page holds 8 rows of pixels */
+#define SSD1306_PAGES (SSD1306_HEIGHT / 8)
+
 /* Buffer to contain pixels color on oled display*/
-#define BUFFER_SIZE (SSD1306_WIDTH * (SSD1306_HEIGHT / 8) + 1)
+#define BUFFER_SIZE (SSD1306_WIDTH * SSD1306_PAGES + 1)
+
+/* Smaller of two values */
+#define SSD1306_MIN(a, b) (((a) < (b)) ? (a) : (b))
+
+/* Index of the first pixel byte of page/column in buffer */
+#define BUFFER_INDEX(page, col) (1 + (page) * SSD1306_WIDTH + (col))
+
+/* Max number of command bytes sent in one transaction */
+#define SSD1306_MAX_COMMANDS 32
 
-/* buffer to hold sent pixels */
+/* Time to wait for the previous flush to finish in ms */
+#define SSD1306_FLUSH_TIMEOUT 100
+
+/* two buffers to hold pixels, one is drawn while other is sent */
 /* first element = SSD1306_DATA */
-static uint8_t buffer[BUFFER_SIZE];
+static uint8_t buffers[2][BUFFER_SIZE];
+
+/* back buffer, all drawing functions write here */
+static uint8_t* buffer = buffers[0];
+
+/* front buffer, streamed to screen by flush task */
+static uint8_t* front = buffers[1];
+
+/**
+ * Range of modified columns in a single page since last update.
+ * Page is clean when col_start > col_end.
+ */
+struct ssd1306_dirty
+{
+    uint8_t col_start; /**< First modified column */
+    uint8_t col_end;   /**< Last modified column */
+};
+
+/* Modified areas of the back buffer which have to be sent on next update */
+static struct ssd1306_dirty dirty[SSD1306_PAGES];
+
+/* Modified areas of the front buffer being sent */
+static struct ssd1306_dirty front_dirty[SSD1306_PAGES];
+
+/* Last flush failed, its front_dirty areas are sent again with the next frame */
+static bool flush_failed;
+
+/* Semaphore given to start flush of front buffer */
+static sem_t flush_request_sem;
+static sem_buf_t flush_request_sem_buf;
+
+/* Semaphore given when front buffer is sent and can be reused */
+static sem_t flush_done_sem;
+static sem_buf_t flush_done_sem_buf;
+
+/* Memory of flush task */
+static task_stack_t flush_stack[SSD1306_FLUSH_STACKSIZE];
+static task_buf_t flush_task_buf;
+
+/* Function called from flush task after each finished flush */
+static ssd1306_flush_callback_t flush_callback;
+
+/* Tags of the back and front buffer frames, passed to flush callback */
+static uint32_t frame_tag;
+static uint32_t front_tag;
+
+/* Data transfers of the flush, one per page at most */
+static struct i2c_transfer window_transfers[SSD1306_PAGES];
+
+/* Buffer bytes replaced by SSD1306_DATA control byte of each window */
+static uint8_t window_saved[SSD1306_PAGES];
+
+/* Initialization commands with arguments, sent in one transaction */
+static const uint8_t ssd1306_init_commands[] = {
+    SSD1306_DISPLAYOFF,
+    SSD1306_SETDISPLAYCLOCKDIV, 0x80,
+    SSD1306_SETMULTIPLEX, SSD1306_HEIGHT - 1,
+    SSD1306_SETDISPLAYOFFSET, 0x00,
+    SSD1306_SETSTARTLINE,
+    SSD1306_CHARGEPUMP, 0x14,
+    SSD1306_MEMORYMODE, 0x00,
+    SSD1306_SEGREMAP | 0x10, SSD1306_WIDTH - 1,
+    SSD1306_COMSCANDEC,
+    SSD1306_SETCOMPINS, 0x12,
+    SSD1306_SETCONTRAST, 0x7F,
+    SSD1306_SETPRECHARGE, 0xF1,
+    SSD1306_SETVCOMDETECT, 0x40,
+    SSD1306_DISPLAYALLON_RESUME,
+    SSD1306_NORMALDISPLAY,
+    SSD1306_DEACTIVATE_SCROLL,
+};
+
+/* Commands turning display on after first frame is sent */
+static const uint8_t ssd1306_on_commands[] = {
+    SSD1306_DISPLAYALLON,
+    SSD1306_DISPLAYON,
+};
+
+/**
+ * @brief Write command stream to ssd1306 by I2C
+ *
+ * All commands go in one transaction after single SSD1306_COMMAND control byte.
+ *
+ * @param commands - commands with their arguments
+ * @param len - number of bytes, up to SSD1306_MAX_COMMANDS
+ * @return int32_t - Error code.
+ */
+static int32_t ssd1306_write_commands(const uint8_t* commands, size_t len);
 
 /**
- * @brief Write command to ssd1306 by I2C
+ * @brief Write run of page bytes shifted into one page of buffer
  *
- * @param command
+ * Only bits covered by shifted 0xFF mask are replaced.
+ *
+ * @param page - page number, runs outside the screen are skipped
+ * @param x - first column
+ * @param src - page bytes, NULL for empty run
+ * @param n_cols - number of columns
+ * @param shift - left shift of bytes, negative for right shift
+ */
+static void ssd1306_write_run(int16_t page, uint8_t x, const uint8_t* src, uint8_t n_cols, int8_t shift);
+
+/**
+ * @brief Mark columns of the page as modified
+ *
+ * @param page - page number
+ * @param col_start - first modified column
+ * @param col_end - last modified column
+ */
+static void ssd1306_mark_dirty(uint8_t page, uint8_t col_start, uint8_t col_end);
+
+/**
+ * @brief Mark all pages as clean after update
+ *
+ */
+static void ssd1306_clear_dirty(struct ssd1306_dirty* pages);
+
+/**
+ * @brief Transpose 8x8 block of bitmap pixels into 8 page bytes
+ *
+ * @param rows - 8 bitmap rows, MSB is the leftmost pixel, rows[7] is bit 0 of page byte
+ * @param cols - 8 page bytes, cols[0] is the leftmost column
  */
-static void ssd1306_write_command(uint8_t command);
+static void ssd1306_transpose8(const uint8_t rows[8], uint8_t cols[8]);
 
 /**
- * @brief  Write data to ssd1306 by I2C
+ * @brief OR 8x8 block of bitmap pixels into one page of buffer
  *
- * @param ptr_data
- * @param data_len
+ * @param rows - 8 bitmap rows, see ssd1306_transpose8
+ * @param page - page number
+ * @param x - first column
+ * @param n_cols - number of visible columns, max 8
  */
-static void ssd1306_write_data(uint8_t* data, size_t data_len);
+static void ssd1306_blit_block(const uint8_t rows[8], uint8_t page, uint8_t x, uint8_t n_cols);
 
 /**
- * @brief Drawing char in the selected position
+ * @brief Prepare transfer of part of the buffer as data, starting from selected pixel byte
  *
- * @param x - offset
- * @param y - offset
- * @param c - character
+ * @param frame - buffer to send
+ * @param index - index of the first pixel byte in buffer
+ * @param len - number of pixel bytes to send
+ * @param window - window number, up to SSD1306_PAGES - 1
  */
-static void ssd1306_draw_char(uint8_t x, uint8_t y, char c);
+static void ssd1306_prepare_window(uint8_t* frame, uint16_t index, size_t len, uint8_t window);
+
+/**
+ * @brief Send prepared windows back to back and wait for the last one
+ *
+ * @param n_windows - number of prepared windows
+ * @return int32_t - Error code.
+ */
+static int32_t ssd1306_send_windows(uint8_t n_windows);
+
+/**
+ * @brief Send modified areas of front buffer to screen memory
+ *
+ * @return int32_t - Error code of the first failed transfer.
+ */
+static int32_t ssd1306_flush(void);
+
+/**
+ * @brief Flush task, sends front buffer each time swap is requested
+ *
+ * @param params Task parameters - unused
+ */
+static void ssd1306_flush_task(void* params);
+
+void ssd1306_task_init(void)
+{
+    flush_request_sem = rtos_sem_bin_create_static(&flush_request_sem_buf);
+    flush_done_sem = rtos_sem_bin_create_static(&flush_done_sem_buf);
+    rtos_sem_give(flush_done_sem);
+
+    rtos_task_create_static(ssd1306_flush_task, "ssd1306_flush", SSD1306_FLUSH_STACKSIZE, SSD1306_FLUSH_PRIORITY, flush_stack, &flush_task_buf);
+}
 
 void ssd1306_init(void)
 {
-    ssd1306_write_command(SSD1306_DISPLAYOFF);
+    ssd1306_write_commands(ssd1306_init_commands, sizeof(ssd1306_init_commands));
 
-    ssd1306_write_command(SSD1306_SETDISPLAYCLOCKDIV);
-    ssd1306_write_command(0x80);
+    ssd1306_clear_screen();
 
-    ssd1306_write_command(SSD1306_SETMULTIPLEX);
-    ssd1306_write_command(SSD1306_HEIGHT - 1);
+    /* Screen memory content is unknown after reset, send whole buffer */
+    for(uint8_t page = 0; page < SSD1306_PAGES; page++)
+    {
+        ssd1306_mark_dirty(page, 0, SSD1306_WIDTH - 1);
+    }
 
-    ssd1306_write_command(SSD1306_SETDISPLAYOFFSET);
-    ssd1306_write_command(0x00);
+    ssd1306_update_screen();
 
-    ssd1306_write_command(SSD1306_SETSTARTLINE);
+    ssd1306_write_commands(ssd1306_on_commands, sizeof(ssd1306_on_commands));
+}
 
-    ssd1306_write_command(SSD1306_CHARGEPUMP);
-    ssd1306_write_command(0x14);
+void ssd1306_clear_screen(void)
+{
+    for(uint8_t page = 0; page < SSD1306_PAGES; page++)
+    {
+        uint8_t* line = &buffer[BUFFER_INDEX(page, 0)];
+        int16_t first = -1;
+        int16_t last = -1;
 
-    ssd1306_write_command(SSD1306_MEMORYMODE);
-    ssd1306_write_command(0x00);
+        /* Only columns with lit pixels differ from cleared screen */
+        for(uint8_t col = 0; col < SSD1306_WIDTH; col++)
+        {
+            if(line[col] != 0)
+            {
+                if(first < 0)
+                {
+                    first = col;
+                }
+                last = col;
+            }
+        }
 
-    ssd1306_write_command(SSD1306_SEGREMAP | 0x10);
-    ssd1306_write_command(SSD1306_WIDTH - 1);
+        if(first >= 0)
+        {
+            ssd1306_mark_dirty(page, first, last);
+        }
+    }
 
-    ssd1306_write_command(SSD1306_COMSCANDEC);
+    memset(buffer, 0x00, BUFFER_SIZE);
+}
 
-    ssd1306_write_command(SSD1306_SETCOMPINS);
-    ssd1306_write_command(0x12);
+void ssd1306_update_screen(void)
+{
+    if(ssd1306_swap_buffers() == 0)
+    {
+        ssd1306_wait_flush(SSD1306_FLUSH_TIMEOUT);
+    }
+}
+
+int32_t ssd1306_swap_buffers(void)
+{
+    /* Front buffer can't be reused before previous flush ends */
+    if(rtos_sem_take(flush_done_sem, SSD1306_FLUSH_TIMEOUT) != true)
+    {
+        return -EBUSY;
+    }
 
-    ssd1306_write_command(SSD1306_SETCONTRAST);
-    ssd1306_write_command(0x7F);
+    uint8_t* tmp = front;
+    front = buffer;
+    buffer = tmp;
 
-    ssd1306_write_command(SSD1306_SETPRECHARGE);
-    ssd1306_write_command(0xF1);
+    /* Next frame is drawn on top of the current one */
+    memcpy(buffer, front, BUFFER_SIZE);
 
-    ssd1306_write_command(SSD1306_SETVCOMDETECT);
-    ssd1306_write_command(0x40);
+    if(flush_failed)
+    {
+        /* Screen still shows older content of areas from failed flush */
+        for(uint8_t page = 0; page < SSD1306_PAGES; page++)
+        {
+            ssd1306_mark_dirty(page, front_dirty[page].col_start, front_dirty[page].col_end);
+        }
+    }
 
-    ssd1306_write_command(SSD1306_DISPLAYALLON_RESUME);
-    ssd1306_write_command(SSD1306_NORMALDISPLAY);
-    ssd1306_write_command(SSD1306_DEACTIVATE_SCROLL);
+    memcpy(front_dirty, dirty, sizeof(dirty));
+    ssd1306_clear_dirty(dirty);
 
-    ssd1306_clear_screen();
+    front_tag = frame_tag;
+    frame_tag = 0;
 
-    ssd1306_update_screen();
+    rtos_sem_give(flush_request_sem);
 
-    ssd1306_write_command(SSD1306_DISPLAYALLON);
-    ssd1306_write_command(SSD1306_DISPLAYON);
+    return 0;
 }
 
-void ssd1306_clear_screen(void)
+int32_t ssd1306_wait_flush(uint32_t ms)
 {
-    memset(buffer, 0x00, BUFFER_SIZE);
+    if(rtos_sem_take(flush_done_sem, ms) != true)
+    {
+        return -EBUSY;
+    }
+
+    rtos_sem_give(flush_done_sem);
+
+    return 0;
 }
 
-void ssd1306_update_screen(void)
+void ssd1306_set_flush_callback(ssd1306_flush_callback_t callback)
+{
+    flush_callback = callback;
+}
+
+void ssd1306_set_frame_tag(uint32_t tag)
 {
-    ssd1306_write_command(SSD1306_PAGEADDR);
-    ssd1306_write_command(0x00);
-    ssd1306_write_command(0xFF);
+    frame_tag = tag;
+}
+
+static int32_t ssd1306_flush(void)
+{
+    uint8_t page_start = SSD1306_PAGES;
+    uint8_t page_end = 0;
+    uint8_t col_start = SSD1306_WIDTH - 1;
+    uint8_t col_end = 0;
+
+    /* Find window covering all modified areas */
+    for(uint8_t page = 0; page < SSD1306_PAGES; page++)
+    {
+        if(front_dirty[page].col_start > front_dirty[page].col_end)
+        {
+            continue;
+        }
 
-    ssd1306_write_command(SSD1306_COLUMNADDR);
-    ssd1306_write_command(0x00);
-    ssd1306_write_command(SSD1306_WIDTH - 1);
+        if(page_start == SSD1306_PAGES)
+        {
+            page_start = page;
+        }
+        page_end = page;
+
+        if(front_dirty[page].col_start < col_start)
+        {
+            col_start = front_dirty[page].col_start;
+        }
+        if(front_dirty[page].col_end > col_end)
+        {
+            col_end = front_dirty[page].col_end;
+        }
+    }
+
+    if(page_start == SSD1306_PAGES)
+    {
+        /* Nothing changed since last update */
+        return 0;
+    }
+
+    const uint8_t window[] = {SSD1306_PAGEADDR, page_start, page_end, SSD1306_COLUMNADDR, col_start, col_end};
+    int32_t ret = ssd1306_write_commands(window, sizeof(window));
+
+    if(ret != 0)
+    {
+        /* Data would land in the window of the previous flush */
+        return ret;
+    }
+
+    uint8_t n_windows = 0;
 
-    ssd1306_write_data(buffer, BUFFER_SIZE);
+    if((col_start == 0) && (col_end == SSD1306_WIDTH - 1))
+    {
+        /* Full width pages are contiguous in buffer */
+        ssd1306_prepare_window(front, BUFFER_INDEX(page_start, 0), (page_end - page_start + 1) * SSD1306_WIDTH, n_windows++);
+    }
+    else
+    {
+        /* Screen wraps to col_start of the next page at the end of the window */
+        for(uint8_t page = page_start; page <= page_end; page++)
+        {
+            ssd1306_prepare_window(front, BUFFER_INDEX(page, col_start), col_end - col_start + 1, n_windows++);
+        }
+    }
+
+    return ssd1306_send_windows(n_windows);
 }
 
 void ssd1306_draw_pixel(uint8_t x, uint8_t y)
 {
-    if(x >= (SSD1306_WIDTH + 1) || y >= (SSD1306_HEIGHT + 1))
+    if(x >= SSD1306_WIDTH || y >= SSD1306_HEIGHT)
     {
         /* Prevent writing outside buffer */
         return;
     }
 
     uint8_t y_offset = (SSD1306_HEIGHT - 1) - y;
-    buffer[(x + (y_offset / 8) * SSD1306_WIDTH) + 1] |= (1 << (y_offset & 7));
+    uint8_t page = y_offset / 8;
+    uint8_t mask = (1 << (y_offset & 7));
+    uint8_t* pixels = &buffer[BUFFER_INDEX(page, x)];
+
+    if((*pixels & mask) == 0)
+    {
+        *pixels |= mask;
+        ssd1306_mark_dirty(page, x, x);
+    }
 }
 
 void ssd1306_draw_bitmap(uint8_t x, uint8_t y, uint8_t w, uint8_t h, const uint8_t* bitmap)
 {
-    for(int16_t i = 0; i < h; ++i)
+    if((x >= SSD1306_WIDTH) || (y >= SSD1306_HEIGHT) || (w == 0) || (h == 0))
+    {
+        /* Bitmap completely outside the screen */
+        return;
+    }
+
+    /* Clip once to the visible part of the bitmap */
+    int16_t stride = (w + 7) / 8;
+    int16_t n_cols = SSD1306_MIN(w, SSD1306_WIDTH - x);
+    int16_t n_rows = SSD1306_MIN(h, SSD1306_HEIGHT - y);
+
+    /* Screen is flipped, bitmap row i lands on screen row (SSD1306_HEIGHT - 1 - y - i) */
+    uint8_t page_first = (SSD1306_HEIGHT - y - n_rows) / 8;
+    uint8_t page_last = (SSD1306_HEIGHT - 1 - y) / 8;
+
+    uint8_t rows[8];
+
+    for(uint8_t page = page_first; page <= page_last; page++)
     {
-        for(int16_t j = 0; j < w; ++j)
+        /* Bitmap row placed on bit 7 of the page byte, next rows go down to bit 0 */
+        int16_t row_base = (SSD1306_HEIGHT - 8) - y - page * 8;
+        bool page_aligned = (row_base >= 0) && ((row_base + 8) <= n_rows);
+
+        for(int16_t byte_col = 0; (byte_col * 8) < n_cols; byte_col++)
         {
-            int16_t byte_index = i * (w / 8) + j / 8;
-            int16_t bit_index = j % 8;
+            if(page_aligned)
+            {
+                /* Whole page covered by bitmap, no row checks needed */
+                const uint8_t* src = &bitmap[row_base * stride + byte_col];
 
-            if(bitmap[byte_index] & (1 << (7 - bit_index)))
+                for(uint8_t k = 0; k < 8; k++)
+                {
+                    rows[k] = src[k * stride];
+                }
+            }
+            else
             {
-                ssd1306_draw_pixel(x + j, y + i);
+                for(uint8_t k = 0; k < 8; k++)
+                {
+                    int16_t row = row_base + k;
+                    rows[k] = ((row >= 0) && (row < n_rows)) ? bitmap[row * stride + byte_col] : 0;
+                }
             }
+
+            ssd1306_blit_block(rows, page, x + byte_col * 8, SSD1306_MIN(8, n_cols - byte_col * 8));
         }
     }
 }
 
-void ssd1306_draw_string(uint8_t x, uint8_t y, char* c)
+void ssd1306_draw_pages(uint8_t x, uint8_t page, uint8_t w, uint8_t n_pages, const uint8_t* pages)
 {
-    uint8_t offset = 0;
+    if((x >= SSD1306_WIDTH) || (page >= SSD1306_PAGES))
+    {
+        /* Bitmap completely outside the screen */
+        return;
+    }
 
-    while(*c)
+    uint8_t n_cols = SSD1306_MIN(w, SSD1306_WIDTH - x);
+    uint8_t page_end = SSD1306_MIN(page + n_pages, SSD1306_PAGES);
+
+    for(; page < page_end; page++)
     {
-        ssd1306_draw_char(x + offset, y, *c);
-        offset += (5 + 2);
-        c++;
+        uint8_t* dst = &buffer[BUFFER_INDEX(page, x)];
+
+        /* Copy whole column run, mark dirty only if content differs */
+        if(memcmp(dst, pages, n_cols) != 0)
+        {
+            memcpy(dst, pages, n_cols);
+            ssd1306_mark_dirty(page, x, x + n_cols - 1);
+        }
+
+        pages += w;
     }
 }
 
-void ssd1306_draw_char(uint8_t x, uint8_t y, char c)
+void ssd1306_draw_string(uint8_t x, uint8_t y, char* c)
+{
+    ssd1306_draw_text(x, y, c, &ssd1306_font_5x7);
+}
+
+void ssd1306_draw_text(uint8_t x, uint8_t y, const char* str, const struct ssd1306_font* font)
 {
-    int8_t i, j;
-    uint8_t line;
+    if(y >= SSD1306_HEIGHT)
+    {
+        /* Text completely outside the screen */
+        return;
+    }
 
-    for(i = 0; i < 5; i++)
+    uint16_t glyph_size = font->width * font->pages;
+
+    for(; (*str != '\0') && (x < SSD1306_WIDTH); str++)
     {
-        line = (*(const unsigned char*)(&font[c * 5 + i]));
-        for(j = 0; j <= 7; j++, line >>= 1)
+        uint8_t c = *str;
+        const uint8_t* glyph = NULL;
+
+        if((c >= font->first_char) && (c <= font->last_char))
         {
-            if(line & 1)
+            glyph = &font->glyphs[(c - font->first_char) * glyph_size];
+        }
+
+        for(uint8_t glyph_page = 0; glyph_page < font->pages; glyph_page++)
+        {
+            /* Screen row of bit 0, rows are flipped so bits go up the screen */
+            int16_t base = (SSD1306_HEIGHT - 8) - y - glyph_page * 8;
+            int16_t page = (base >= 0) ? (base / 8) : -((7 - base) / 8);
+            int8_t shift = base - page * 8;
+            const uint8_t* src = (glyph != NULL) ? &glyph[glyph_page * font->width] : NULL;
+
+            ssd1306_write_run(page, x, src, font->width, shift);
+            ssd1306_write_run(page, x + font->width, NULL, font->spacing, shift);
+
+            if(shift != 0)
             {
-                ssd1306_draw_pixel(x + i, y + j);
+                /* Glyph page spans two screen pages */
+                ssd1306_write_run(page + 1, x, src, font->width, shift - 8);
+                ssd1306_write_run(page + 1, x + font->width, NULL, font->spacing, shift - 8);
             }
         }
+
+        x += font->width + font->spacing;
     }
 }
 
-static void ssd1306_write_command(uint8_t command)
+static int32_t ssd1306_write_commands(const uint8_t* commands, size_t len)
 {
-    uint8_t tmp_buf[2];
+    uint8_t tmp_buf[SSD1306_MAX_COMMANDS + 1];
 
+    if(len > SSD1306_MAX_COMMANDS)
+    {
+        return -EINVAL;
+    }
+
+    /* Co bit cleared, every following byte is a command */
     tmp_buf[0] = SSD1306_COMMAND;
-    tmp_buf[1] = command;
+    memcpy(&tmp_buf[1], commands, len);
+
+    return i2c_master_write(tmp_buf, SSD1306_I2C_ADRESS, len + 1);
+}
 
-    i2c_master_write(tmp_buf, SSD1306_I2C_ADRESS, 2);
+static void ssd1306_transpose8(const uint8_t rows[8], uint8_t cols[8])
+{
+    uint32_t hi = ((uint32_t)rows[0] << 24) | ((uint32_t)rows[1] << 16) | ((uint32_t)rows[2] << 8) | rows[3];
+    uint32_t lo = ((uint32_t)rows[4] << 24) | ((uint32_t)rows[5] << 16) | ((uint32_t)rows[6] << 8) | rows[7];
+    uint32_t tmp;
+
+    /* Swap bits in 2x2, then 2x2 blocks in 4x4, then 4x4 blocks in 8x8 */
+    tmp = (hi ^ (hi >> 7)) & 0x00AA00AA;
+    hi = hi ^ tmp ^ (tmp << 7);
+    tmp = (lo ^ (lo >> 7)) & 0x00AA00AA;
+    lo = lo ^ tmp ^ (tmp << 7);
+
+    tmp = (hi ^ (hi >> 14)) & 0x0000CCCC;
+    hi = hi ^ tmp ^ (tmp << 14);
+    tmp = (lo ^ (lo >> 14)) & 0x0000CCCC;
+    lo = lo ^ tmp ^ (tmp << 14);
+
+    tmp = (hi & 0xF0F0F0F0) | ((lo >> 4) & 0x0F0F0F0F);
+    lo = ((hi << 4) & 0xF0F0F0F0) | (lo & 0x0F0F0F0F);
+    hi = tmp;
+
+    cols[0] = hi >> 24;
+    cols[1] = hi >> 16;
+    cols[2] = hi >> 8;
+    cols[3] = hi;
+    cols[4] = lo >> 24;
+    cols[5] = lo >> 16;
+    cols[6] = lo >> 8;
+    cols[7] = lo;
 }
 
-static void ssd1306_write_data(uint8_t* data, size_t data_len)
+static void ssd1306_blit_block(const uint8_t rows[8], uint8_t page, uint8_t x, uint8_t n_cols)
 {
-    data[0] = SSD1306_DATA;
+    if((rows[0] | rows[1] | rows[2] | rows[3] | rows[4] | rows[5] | rows[6] | rows[7]) == 0)
+    {
+        /* Nothing to draw */
+        return;
+    }
+
+    uint8_t cols[8];
+    ssd1306_transpose8(rows, cols);
 
-    i2c_master_write(data, SSD1306_I2C_ADRESS, data_len);
+    uint8_t* pixels = &buffer[BUFFER_INDEX(page, x)];
+    int8_t first = -1;
+    int8_t last = -1;
+
+    for(uint8_t col = 0; col < n_cols; col++)
+    {
+        uint8_t val = pixels[col] | cols[col];
+
+        if(val != pixels[col])
+        {
+            pixels[col] = val;
+            if(first < 0)
+            {
+                first = col;
+            }
+            last = col;
+        }
+    }
+
+    if(first >= 0)
+    {
+        ssd1306_mark_dirty(page, x + first, x + last);
+    }
+}
+
+static void ssd1306_write_run(int16_t page, uint8_t x, const uint8_t* src, uint8_t n_cols, int8_t shift)
+{
+    if((page < 0) || (page >= SSD1306_PAGES) || (x >= SSD1306_WIDTH))
+    {
+        /* Run outside the screen */
+        return;
+    }
+
+    n_cols = SSD1306_MIN(n_cols, SSD1306_WIDTH - x);
+    uint8_t* dst = &buffer[BUFFER_INDEX(page, x)];
+
+    if((shift == 0) && (src != NULL))
+    {
+        /* Page aligned, glyph bytes copied as they are */
+        if(memcmp(dst, src, n_cols) != 0)
+        {
+            memcpy(dst, src, n_cols);
+            ssd1306_mark_dirty(page, x, x + n_cols - 1);
+        }
+        return;
+    }
+
+    uint8_t mask = (shift >= 0) ? (uint8_t)(0xFF << shift) : (uint8_t)(0xFF >> -shift);
+    int8_t first = -1;
+    int8_t last = -1;
+
+    for(uint8_t col = 0; col < n_cols; col++)
+    {
+        uint8_t bits = 0;
+
+        if(src != NULL)
+        {
+            bits = (shift >= 0) ? (uint8_t)(src[col] << shift) : (uint8_t)(src[col] >> -shift);
+        }
+
+        uint8_t val = (dst[col] & ~mask) | bits;
+
+        if(val != dst[col])
+        {
+            dst[col] = val;
+            if(first < 0)
+            {
+                first = col;
+            }
+            last = col;
+        }
+    }
+
+    if(first >= 0)
+    {
+        ssd1306_mark_dirty(page, x + first, x + last);
+    }
+}
+
+static void ssd1306_prepare_window(uint8_t* frame, uint16_t index, size_t len, uint8_t window)
+{
+    /* Byte before the window is borrowed for SSD1306_DATA control byte, windows of different pages never borrow each other bytes */
+    uint8_t* data = &frame[index - 1];
+
+    window_saved[window] = *data;
+    *data = SSD1306_DATA;
+
+    window_transfers[window] = (struct i2c_transfer){
+        .slave_addr = SSD1306_I2C_ADRESS,
+        .tx_data = data,
+        .tx_len = len + 1,
+    };
+}
+
+static int32_t ssd1306_send_windows(uint8_t n_windows)
+{
+    int32_t ret;
+
+    /* Queued at once, so pages go without gaps between transfers */
+    window_transfers[n_windows - 1].notify_task = rtos_task_current();
+
+    for(uint8_t i = 0; i < n_windows; i++)
+    {
+        i2c_master_submit(&window_transfers[i]);
+    }
+
+    ret = i2c_master_wait(&window_transfers[n_windows - 1], SSD1306_FLUSH_TIMEOUT);
+
+    for(uint8_t i = 0; i < n_windows; i++)
+    {
+        /* Nothing to abort unless waiting timed out */
+        i2c_master_abort(&window_transfers[i]);
+        window_transfers[i].tx_data[0] = window_saved[i];
+
+        if((ret == 0) && (window_transfers[i].status != 0))
+        {
+            /* Last window may succeed after earlier one failed */
+            ret = window_transfers[i].status;
+        }
+    }
+
+    return ret;
+}
+
+static void ssd1306_mark_dirty(uint8_t page, uint8_t col_start, uint8_t col_end)
+{
+    if(col_start < dirty[page].col_start)
+    {
+        dirty[page].col_start = col_start;
+    }
+
+    if(col_end > dirty[page].col_end)
+    {
+        dirty[page].col_end = col_end;
+    }
+}
+
+static void ssd1306_clear_dirty(struct ssd1306_dirty* pages)
+{
+    for(uint8_t page = 0; page < SSD1306_PAGES; page++)
+    {
+        pages[page].col_start = SSD1306_WIDTH - 1;
+        pages[page].col_end = 0;
+    }
+}
+
+static void ssd1306_flush_task(void* params)
+{
+    (void)params;
+
+    while(1)
+    {
+        rtos_sem_take(flush_request_sem, portMAX_DELAY);
+
+        /* Read by next swap after flush_done_sem is given */
+        flush_failed = (ssd1306_flush() != 0);
+
+        /* Next swap may replace front tag as soon as flush is done */
+        uint32_t tag = front_tag;
+
+        rtos_sem_give(flush_done_sem);
+
+        if(flush_callback != NULL)
+        {
+            flush_callback(tag);
+        }
+    }
 }
\ No newline at end of file
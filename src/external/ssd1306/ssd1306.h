@@ -44,6 +44,34 @@
 
 #define SSD1306_SETSTARTLINE 0x40   //< See datasheet
 
+/**
+ * Font with glyphs stored as screen buffer page bytes.
+ * Each glyph is (pages * width) bytes, top page first, bit 7 is the top row.
+ */
+struct ssd1306_font
+{
+    const uint8_t* glyphs; /**< Glyphs data, starting from first_char */
+    uint8_t first_char;    /**< First char in the font */
+    uint8_t last_char;     /**< Last char in the font */
+    uint8_t width;         /**< Glyph width in columns */
+    uint8_t pages;         /**< Glyph height in pages */
+    uint8_t spacing;       /**< Empty columns after glyph */
+};
+
+/**
+ * @brief Function called by flush task when frame is sent to screen
+ *
+ * @param tag - value set by ssd1306_set_frame_tag() while the frame was drawn, 0 if none
+ */
+typedef void (*ssd1306_flush_callback_t)(uint32_t tag);
+
+/**
+ * @brief Create synchronization objects and flush task
+ *
+ * Has to be called before ssd1306_init.
+ */
+void ssd1306_task_init(void);
+
 /**
  * @brief Initalization ssd1306
  *
@@ -53,16 +81,56 @@ void ssd1306_init(void);
 /**
  * @brief Set all pixels as black color
  *
- * @param color
+ * Only columns with lit pixels are marked modified. Drawing functions
+ * compare before writing too, so frames are drawn over the previous one
+ * without clearing and unchanged content is never sent again.
  */
 void ssd1306_clear_screen(void);
 
 /**
  * @brief Send data from buffer to screen memory
  *
+ * Only pages and columns modified since the previous update are sent.
+ * Blocks until the frame is on the screen.
  */
 void ssd1306_update_screen(void);
 
+/**
+ * @brief Pass drawn frame to flush task and continue drawing on a copy
+ *
+ * Waits only for the previous frame flush to finish, the new frame is
+ * sent in the background.
+ *
+ * @return int32_t - 0 on success, -EBUSY if previous flush didn't end
+ */
+int32_t ssd1306_swap_buffers(void);
+
+/**
+ * @brief Wait until the last swapped frame is sent to screen
+ *
+ * @param ms - time to wait in ms
+ * @return int32_t - 0 on success, -EBUSY on timeout
+ */
+int32_t ssd1306_wait_flush(uint32_t ms);
+
+/**
+ * @brief Set function called after each finished flush
+ *
+ * Callback runs in flush task context, NULL disables notification.
+ *
+ * @param callback
+ */
+void ssd1306_set_flush_callback(ssd1306_flush_callback_t callback);
+
+/**
+ * @brief Set value passed to flush callback with the frame being drawn
+ *
+ * Tag is reset to 0 on each swap.
+ *
+ * @param tag - value identifying the frame
+ */
+void ssd1306_set_frame_tag(uint32_t tag);
+
 /**
  * @brief Draw one white pixel in the selected position
  *
@@ -84,7 +152,20 @@ void ssd1306_draw_pixel(uint8_t x, uint8_t y);
 void ssd1306_draw_bitmap(uint8_t x, uint8_t y, uint8_t w, uint8_t h, const uint8_t* bitmap);
 
 /**
- * @brief Drawing string in the selected position
+ * @brief Draw bitmap already converted to screen pages by bitmap_pages.py
+ *
+ * Page bytes are copied, previous content of covered columns is replaced.
+ *
+ * @param x - first column
+ * @param page - first screen page
+ * @param w - width of single page in bytes
+ * @param n_pages - number of pages
+ * @param pages - page bytes, page after page
+ */
+void ssd1306_draw_pages(uint8_t x, uint8_t page, uint8_t w, uint8_t n_pages, const uint8_t* pages);
+
+/**
+ * @brief Drawing string in the selected position with 5x7 font
  *
  * @param x
  * @param y
@@ -92,4 +173,17 @@ void ssd1306_draw_bitmap(uint8_t x, uint8_t y, uint8_t w, uint8_t h, const uint8
  */
 void ssd1306_draw_string(uint8_t x, uint8_t y, char* c);
 
+/**
+ * @brief Drawing string in the selected position with selected font
+ *
+ * Whole glyph cells are written, so previous text is replaced. Chars
+ * outside the font are drawn as empty cells.
+ *
+ * @param x - left column
+ * @param y - top row
+ * @param str - string to draw
+ * @param font - font from ssd1306_fonts.h
+ */
+void ssd1306_draw_text(uint8_t x, uint8_t y, const char* str, const struct ssd1306_font* font);
+
 #endif   // __SSD1306_H__
\ No newline at end of file
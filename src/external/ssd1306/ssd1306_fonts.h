@@ -0,0 +1,21 @@
+/**
+ * @file ssd1306_fonts.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Fonts for ssd1306, glyphs generated at build time by font_pages.py
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef __SSD1306_FONTS_H__
+#define __SSD1306_FONTS_H__
+
+#include "ssd1306.h"
+
+/* Standard ascii 5x7 font, one page high */
+extern const struct ssd1306_font ssd1306_font_5x7;
+
+/* Large digits 10x14 for speed readout, two pages high, chars ' ' to '9' */
+extern const struct ssd1306_font ssd1306_font_digits_10x14;
+
+#endif   // __SSD1306_FONTS_H__
@@ -0,0 +1,278 @@
+/**
+ * @file battery.c
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Battery voltage measurement with ADC1 and DMA
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "battery.h"
+#include "cpu_stats.h"
+#include "dma_f4.h"
+#include "gpio_f4.h"
+
+/** Battery divider pin number - PA01, ADC1 channel 1. */
+#define BATTERY_PIN 1
+/** ADC channel of battery divider. */
+#define BATTERY_ADC_CHANNEL 1
+/** ADC channel of internal reference voltage. */
+#define VREFINT_ADC_CHANNEL 17
+
+/** Battery divider ratio, battery voltage = pin voltage * NUM / DEN. */
+#define BATTERY_DIVIDER_NUM 2
+#define BATTERY_DIVIDER_DEN 1
+
+/** VREFINT raw value measured in production at VREFINT_CAL_MV supply, 30 degC. */
+#define VREFINT_CAL (*(const uint16_t*)0x1FFF7A2AUL)
+/** Supply voltage of VREFINT calibration in mV. */
+#define VREFINT_CAL_MV 3300ULL
+
+/** Full scale of 12-bit ADC. */
+#define ADC_FULL_SCALE 4095ULL
+
+/** DMA stream used for ADC1 - DMA2 Stream0 Channel 0. */
+#define BATTERY_DMA DMA2_Stream0
+
+/** Conversions in one scan: battery, VREFINT. */
+#define BATTERY_SCAN_LEN 2
+/** Scans averaged by each half of the DMA buffer, interrupt every 64 ms at 1 kHz scan rate. */
+#define BATTERY_OVERSAMPLING 64
+/** DMA buffer length, two halves of scans. */
+#define BATTERY_BUF_LEN (2 * BATTERY_OVERSAMPLING * BATTERY_SCAN_LEN)
+
+/** ADC sample time 480 cycles, VREFINT needs at least 10 us. */
+#define ADC_SMP_480 7
+/** ADC clock prescaler APB2 / 8, 5.25 MHz. */
+#define ADC_PRESCALER_DIV8 3
+
+/** Scan trigger timer - TIM3, TRGO on update. */
+#define BATTERY_TIM TIM3
+/** Clock of TIM3, APB1 timers run at twice APB1 frequency (42 MHz). */
+#define BATTERY_TIM_CLOCK_FREQ (APB1_CLOCK_FREQ * 2)
+/** Prescaler for 10 kHz timer ticks. */
+#define BATTERY_TIM_PSC ((BATTERY_TIM_CLOCK_FREQ / 10000) - 1)
+/** Timer ticks per scan, 1 kHz scan rate. */
+#define BATTERY_TIM_TICKS 10
+
+/** ADC1 external trigger TIM3 TRGO, rising edge. */
+#define ADC_EXTSEL_TIM3_TRGO ADC_CR2_EXTSEL_3
+
+/** Age of measurement in ms after which STOP mode waits for the next one. */
+#define BATTERY_MAX_AGE_MS 1000
+
+/** Fractional bits of filtered value. */
+#define BATTERY_FILTER_FRAC 8
+/** Filter time constant as power of two of buffer halves (64 ms each), 2 halves, about 0.13 s. */
+#define BATTERY_FILTER_SHIFT 1
+
+/** ADC results written by DMA, scans of battery and VREFINT. */
+static uint16_t adc_buf[BATTERY_BUF_LEN];
+
+/** Filtered battery voltage in mV with BATTERY_FILTER_FRAC fractional bits, 0 before first measurement. */
+static uint32_t filtered_mv;
+
+/** Published battery voltage in mV, 0 before first measurement. */
+static volatile uint32_t battery_mv;
+
+/** Tick of the last measurement. */
+static volatile tick_t measured_tick;
+
+/** Task notified about voltage change, NULL if none. */
+static void* notify_task;
+/** Notification bits of voltage change. */
+static uint32_t notify_bits;
+/** Change of voltage causing notification in mV. */
+static uint32_t notify_threshold_mv;
+/** Voltage sent with the last notification in mV. */
+static uint32_t notified_mv;
+
+/**
+ * Initialization of ADC1 in scan mode triggered by timer.
+ */
+static void adc_init(void);
+
+/**
+ * Initialization of timer triggering ADC1 scans.
+ */
+static void tim_init(void);
+
+/**
+ * Initialization of circular DMA for ADC1.
+ */
+static void dma_init(void);
+
+/**
+ * Average half of DMA buffer and update filtered voltage.
+ *
+ * @param scans         First scan of the half.
+ * @param yield         Flag indicating if context switch is needed.
+ */
+static void battery_process_isr(const uint16_t* scans, int32_t* yield);
+
+void battery_init(void)
+{
+    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
+    gpio_mode_config(GPIOA, BATTERY_PIN, GPIO_MODE_ANALOG);
+
+    dma_init();
+    adc_init();
+    tim_init();
+}
+
+void battery_set_notify(void* task, uint32_t bits, uint32_t threshold_mv)
+{
+    NVIC_DisableIRQ(DMA2_Stream0_IRQn);
+
+    notify_task = task;
+    notify_bits = bits;
+    notify_threshold_mv = threshold_mv;
+    /* First measurement is always notified */
+    notified_mv = 0;
+
+    NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+}
+
+bool battery_idle(void)
+{
+    if(battery_mv == 0)
+    {
+        /* First measurement isn't done yet */
+        return false;
+    }
+
+    return (rtos_tick_count_get() - measured_tick) < (BATTERY_MAX_AGE_MS / portTICK_RATE_MS);
+}
+
+int32_t battery_get_mv(void)
+{
+    uint32_t mv = battery_mv;
+
+    if(mv == 0)
+    {
+        return -ENODATA;
+    }
+
+    return mv;
+}
+
+static void adc_init(void)
+{
+    RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+
+    /* Enable VREFINT, slowest ADC clock is enough for battery */
+    ADC->CCR = ADC_CCR_TSVREFE | (ADC_PRESCALER_DIV8 << 16);
+
+    ADC1->CR1 = ADC_CR1_SCAN;
+    ADC1->SMPR1 = (ADC_SMP_480 << (3 * (VREFINT_ADC_CHANNEL - 10)));
+    ADC1->SMPR2 = (ADC_SMP_480 << (3 * BATTERY_ADC_CHANNEL));
+
+    /* Scan of two conversions, battery then VREFINT */
+    ADC1->SQR1 = ((BATTERY_SCAN_LEN - 1) << 20);
+    ADC1->SQR3 = BATTERY_ADC_CHANNEL | (VREFINT_ADC_CHANNEL << 5);
+
+    /* Scan on each timer event instead of continuous conversions, so core sleeps between DMA halves */
+    ADC1->CR2 = ADC_CR2_ADON | ADC_CR2_DMA | ADC_CR2_DDS | ADC_EXTSEL_TIM3_TRGO | ADC_CR2_EXTEN_0;
+}
+
+static void tim_init(void)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_TIM3EN;
+
+    BATTERY_TIM->PSC = BATTERY_TIM_PSC;
+    BATTERY_TIM->ARR = BATTERY_TIM_TICKS - 1;
+    BATTERY_TIM->CR2 = TIM_CR2_MMS_1;
+    BATTERY_TIM->EGR = TIM_EGR_UG;
+    BATTERY_TIM->CR1 = TIM_CR1_CEN;
+}
+
+static void dma_init(void)
+{
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA2EN;
+
+    BATTERY_DMA->CR = (DMA_CHANNEL_0 << DMA_CR_CHSEL_BIT) | /* Set channel 0 */
+        (DMA_PRIO_LOW << DMA_CR_PL_BIT) |                   /* Priority set to low */
+        (DMA_SIZE_16BIT << DMA_CR_MSIZE_BIT) |              /* Set memory size */
+        (DMA_SIZE_16BIT << DMA_CR_PSIZE_BIT) |              /* Set peripheral size */
+        DMA_SxCR_MINC |                                     /* Memory increment */
+        DMA_SxCR_CIRC |                                     /* Circular mode */
+        (DMA_DIR_PERIPH_TO_MEM << DMA_CR_DIR_BIT) |         /* Set direction */
+        DMA_SxCR_HTIE |                                     /* Half transfer IRQ */
+        DMA_SxCR_TCIE;                                      /* Transfer complete IRQ */
+
+    BATTERY_DMA->PAR = (uint32_t)&ADC1->DR;
+    BATTERY_DMA->M0AR = (uint32_t)adc_buf;
+    BATTERY_DMA->NDTR = BATTERY_BUF_LEN;
+
+    BATTERY_DMA->CR |= DMA_SxCR_EN;
+
+    NVIC_SetPriority(DMA2_Stream0_IRQn, DMA_BATTERY_PRIORITY);
+    NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+}
+
+static void battery_process_isr(const uint16_t* scans, int32_t* yield)
+{
+    uint32_t battery_sum = 0;
+    uint32_t vrefint_sum = 0;
+
+    for(uint32_t i = 0; i < BATTERY_OVERSAMPLING * BATTERY_SCAN_LEN; i += BATTERY_SCAN_LEN)
+    {
+        battery_sum += scans[i];
+        vrefint_sum += scans[i + 1];
+    }
+
+    if(vrefint_sum == 0)
+    {
+        return;
+    }
+
+    /* VDDA = VREFINT_CAL_MV * VREFINT_CAL / vrefint, number of samples cancels out */
+    uint64_t pin_mv = (VREFINT_CAL_MV * VREFINT_CAL * battery_sum) / (vrefint_sum * ADC_FULL_SCALE);
+    uint32_t mv = (pin_mv * BATTERY_DIVIDER_NUM) / BATTERY_DIVIDER_DEN;
+
+    if(filtered_mv == 0)
+    {
+        /* Start from the first value, no slow rise after reset */
+        filtered_mv = mv << BATTERY_FILTER_FRAC;
+    }
+    else
+    {
+        /* Exponential moving average */
+        filtered_mv += (int32_t)((mv << BATTERY_FILTER_FRAC) - filtered_mv) >> BATTERY_FILTER_SHIFT;
+    }
+
+    mv = (filtered_mv + (1 << (BATTERY_FILTER_FRAC - 1))) >> BATTERY_FILTER_FRAC;
+    battery_mv = mv;
+    measured_tick = rtos_tick_count_get_isr();
+
+    uint32_t change = (mv > notified_mv) ? (mv - notified_mv) : (notified_mv - mv);
+
+    if((notify_task != NULL) && (change >= notify_threshold_mv))
+    {
+        notified_mv = mv;
+        rtos_task_notify_bits_isr(notify_task, notify_bits, yield);
+    }
+}
+
+void DMA2_Stream0_IRQHandler(void)
+{
+    uint32_t start = cpu_stats_isr_enter(CPU_STATS_ISR_BATTERY_DMA);
+    int32_t yield = 0;
+    uint32_t lisr = DMA2->LISR;
+
+    DMA2->LIFCR = DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTCIF0;
+
+    /* Process half not written by DMA */
+    if((lisr & DMA_LISR_HTIF0) != 0)
+    {
+        battery_process_isr(&adc_buf[0], &yield);
+    }
+
+    if((lisr & DMA_LISR_TCIF0) != 0)
+    {
+        battery_process_isr(&adc_buf[BATTERY_BUF_LEN / 2], &yield);
+    }
+
+    cpu_stats_isr_exit(CPU_STATS_ISR_BATTERY_DMA, start);
+    portYIELD_FROM_ISR(yield);
+}
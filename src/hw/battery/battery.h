@@ -0,0 +1,58 @@
+/**
+ * @file battery.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Battery voltage measurement with ADC1 and DMA
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _BATTERY_H_
+#define _BATTERY_H_
+
+#include "platform_specific.h"
+
+/**
+ * Initialize battery measurement.
+ *
+ * ADC1 scan of battery divider and VREFINT is triggered by TIM3 and moved
+ * into circular DMA buffer. Half transfer and transfer complete interrupts
+ * average each half of the buffer, so no task takes part in the measurement.
+ * TIM3, ADC1 and DMA2 are stopped in STOP mode, see battery_idle().
+ */
+void battery_init(void);
+
+/**
+ * Get filtered battery voltage.
+ *
+ * Supply voltage is measured with VREFINT and its factory calibration, so
+ * result doesn't depend on VDDA accuracy.
+ *
+ * @return              Battery voltage in mV, -ENODATA before first measurement.
+ */
+int32_t battery_get_mv(void);
+
+/**
+ * Set task notified when battery voltage changes.
+ *
+ * Notification is sent from interrupt once voltage moves by threshold from
+ * the last notified value, so small noise doesn't wake the task.
+ *
+ * @param task          Task handle, NULL disables notification.
+ * @param bits          Bits set in task notification value.
+ * @param threshold_mv  Change of voltage in mV.
+ */
+void battery_set_notify(void* task, uint32_t bits, uint32_t threshold_mv);
+
+/**
+ * Check if measurement is fresh enough to enter STOP mode.
+ *
+ * Scans don't run in STOP mode, so once the last measurement gets older
+ * than BATTERY_MAX_AGE_MS STOP mode waits for the next half of the buffer,
+ * about 64 ms of sleep mode.
+ *
+ * @return              true when battery voltage was measured recently.
+ */
+bool battery_idle(void);
+
+#endif /* _BATTERY_H_ */
@@ -0,0 +1,191 @@
+/**
+ * @file button.c
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Debounced button with short and long press detection
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "button.h"
+#include "cpu_stats.h"
+#include "gpio_f4.h"
+
+/** Button pin number - PA00, EXTI line 0, high when pressed. */
+#define BUTTON_PIN 0
+
+/** Time the level has to be stable after an edge in ms. */
+#define BUTTON_DEBOUNCE_MS 20
+/** Time of holding the button reported as long press in ms. */
+#define BUTTON_LONG_PRESS_MS 800
+
+/** Debounce timer - TIM11 clocked with 84 MHz. */
+#define BUTTON_TIM TIM11
+/** Timer prescaler giving 10 kHz tick. */
+#define BUTTON_TIM_PSC (8400 - 1)
+/** Timer ticks per ms. */
+#define BUTTON_TIM_TICKS_MS 10
+
+/**
+ * Debounced states of the button.
+ */
+enum button_state
+{
+    BUTTON_RELEASED, /**< Button released */
+    BUTTON_PRESSED,  /**< Button pressed, long press not reported yet */
+    BUTTON_HELD,     /**< Button pressed, long press reported */
+};
+
+/** Debounced state of the button. */
+static enum button_state state;
+
+/** Time of holding debounced press in ms, updated in interrupts. */
+static uint32_t pressed_ms;
+
+/** Task notified about events. */
+static void* volatile notify_task;
+
+/**
+ * Start one pulse of the debounce timer.
+ *
+ * @param ms            Time to the timer interrupt.
+ */
+static void button_timer_start(uint32_t ms);
+
+/**
+ * Report event to the notified task.
+ *
+ * @param event         BUTTON_EVENT_ bit.
+ * @param yield         Flag indicating if context switch is needed.
+ */
+static void button_notify_isr(uint32_t event, int32_t* yield);
+
+void button_init(void)
+{
+    state = BUTTON_RELEASED;
+
+    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN;
+    gpio_mode_config(GPIOA, BUTTON_PIN, GPIO_MODE_INPUT);
+    /* Open button reads low instead of floating and firing EXTI */
+    gpio_pupd_config(GPIOA, BUTTON_PIN, GPIO_PUPD_PD);
+
+    /* One pulse timer, interrupt only on overflow, not on update generation */
+    RCC->APB2ENR |= RCC_APB2ENR_TIM11EN;
+    BUTTON_TIM->PSC = BUTTON_TIM_PSC;
+    BUTTON_TIM->CR1 = TIM_CR1_OPM | TIM_CR1_URS;
+    BUTTON_TIM->DIER = TIM_DIER_UIE;
+
+    NVIC_SetPriority(TIM1_TRG_COM_TIM11_IRQn, TIM_BUTTON_PRIORITY);
+    NVIC_EnableIRQ(TIM1_TRG_COM_TIM11_IRQn);
+
+    /* EXTI line 0 connected to port A by default, both edges */
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    SYSCFG->EXTICR[0] &= ~SYSCFG_EXTICR1_EXTI0;
+    EXTI->RTSR |= (1 << BUTTON_PIN);
+    EXTI->FTSR |= (1 << BUTTON_PIN);
+    EXTI->PR = (1 << BUTTON_PIN);
+    EXTI->IMR |= (1 << BUTTON_PIN);
+
+    NVIC_SetPriority(EXTI0_IRQn, EXTI_BUTTON_PRIORITY);
+    NVIC_EnableIRQ(EXTI0_IRQn);
+}
+
+void button_set_notify(void* task)
+{
+    notify_task = task;
+}
+
+bool button_idle(void)
+{
+    return (BUTTON_TIM->CR1 & TIM_CR1_CEN) == 0;
+}
+
+static void button_timer_start(uint32_t ms)
+{
+    BUTTON_TIM->CR1 &= ~TIM_CR1_CEN;
+    BUTTON_TIM->ARR = (ms * BUTTON_TIM_TICKS_MS) - 1;
+    /* Reload prescaler and counter */
+    BUTTON_TIM->EGR = TIM_EGR_UG;
+    BUTTON_TIM->SR = 0;
+    BUTTON_TIM->CR1 |= TIM_CR1_CEN;
+}
+
+static void button_notify_isr(uint32_t event, int32_t* yield)
+{
+    void* task = notify_task;
+
+    if(task != NULL)
+    {
+        rtos_task_notify_bits_isr(task, event, yield);
+    }
+}
+
+void EXTI0_IRQHandler(void)
+{
+    uint32_t start = cpu_stats_isr_enter(CPU_STATS_ISR_BUTTON_EXTI);
+    EXTI->PR = (1 << BUTTON_PIN);
+
+    /* Bouncing edges only restart the timer, level is checked when it is stable */
+    if(state == BUTTON_PRESSED)
+    {
+        /* Keep counting long press time of debounced press */
+        pressed_ms += (BUTTON_TIM->CNT / BUTTON_TIM_TICKS_MS);
+    }
+
+    button_timer_start(BUTTON_DEBOUNCE_MS);
+
+    cpu_stats_isr_exit(CPU_STATS_ISR_BUTTON_EXTI, start);
+}
+
+void TIM1_TRG_COM_TIM11_IRQHandler(void)
+{
+    if((BUTTON_TIM->SR & TIM_SR_UIF) == 0)
+    {
+        /* Vector shared with TIM1, sample only on debounce timer overflow */
+        return;
+    }
+
+    uint32_t start = cpu_stats_isr_enter(CPU_STATS_ISR_BUTTON_TIM);
+    int32_t yield = 0;
+    bool pressed = (GPIOA->IDR & (1 << BUTTON_PIN)) != 0;
+    uint32_t elapsed = (BUTTON_TIM->ARR + 1) / BUTTON_TIM_TICKS_MS;
+
+    BUTTON_TIM->SR = 0;
+
+    if(!pressed)
+    {
+        if(state == BUTTON_PRESSED)
+        {
+            button_notify_isr(BUTTON_EVENT_SHORT, &yield);
+        }
+
+        state = BUTTON_RELEASED;
+    }
+    else if(state == BUTTON_RELEASED)
+    {
+        /* Debounced press, wait for long press time */
+        state = BUTTON_PRESSED;
+        pressed_ms = 0;
+        button_timer_start(BUTTON_LONG_PRESS_MS);
+    }
+    else if(state == BUTTON_PRESSED)
+    {
+        pressed_ms += elapsed;
+
+        if(pressed_ms >= BUTTON_LONG_PRESS_MS)
+        {
+            button_notify_isr(BUTTON_EVENT_LONG, &yield);
+            state = BUTTON_HELD;
+        }
+        else
+        {
+            /* Short bounce during press, wait for the rest of long press time */
+            button_timer_start(BUTTON_LONG_PRESS_MS - pressed_ms);
+        }
+    }
+    else
+    {}
+
+    cpu_stats_isr_exit(CPU_STATS_ISR_BUTTON_TIM, start);
+    portYIELD_FROM_ISR(yield);
+}
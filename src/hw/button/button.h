@@ -0,0 +1,44 @@
+/**
+ * @file button.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Debounced button with short and long press detection
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _BUTTON_H_
+#define _BUTTON_H_
+
+#include "platform_specific.h"
+
+/** Notification bit set after button released before long press time. */
+#define BUTTON_EVENT_SHORT (1 << 0)
+/** Notification bit set when button is held for long press time. */
+#define BUTTON_EVENT_LONG (1 << 1)
+
+/**
+ * Initialize button input.
+ *
+ * Edges are caught by EXTI, level is sampled by hardware timer after debounce
+ * time, so events are delivered without any task polling the pin.
+ */
+void button_init(void);
+
+/**
+ * Set task notified about button events.
+ *
+ * Events are set as BUTTON_EVENT_ bits in task notification value.
+ *
+ * @param task          Task handle, NULL disables notification.
+ */
+void button_set_notify(void* task);
+
+/**
+ * Check if debounce timer is stopped, timer doesn't run in STOP mode.
+ *
+ * @return              true when no edge is being debounced or timed.
+ */
+bool button_idle(void);
+
+#endif /* _BUTTON_H_ */
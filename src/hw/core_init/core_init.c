@@ -25,11 +25,6 @@
 
 void core_init(void)
 {
-    /* Start HSE and wait for it to be ready */
-    RCC->CR |= RCC_CR_HSEON;
-    while(!(RCC->CR & RCC_CR_HSERDY))
-        ;
-
     /* FLASH configuration*/
     FLASH->ACR = FLASH_ACR_ICEN | /* instruction cache */
         FLASH_ACR_DCEN |          /* data cache */
@@ -38,17 +33,31 @@ void core_init(void)
 
     /* Set HSE as PLL source, set M, N, P, Q miltipliers and dividers */
     RCC->PLLCFGR = (PLL_Q << 24) | RCC_PLLCFGR_PLLSRC_HSE | (((PLL_P >> 1) - 1) << 16) | (PLL_N << 6) | PLL_M;
+
+    /* Prescaler 2 for APB2, prescaler 4 for APB1 */
+    RCC->CFGR |= RCC_CFGR_PPRE1_DIV4 | RCC_CFGR_PPRE2_DIV2;
+
+    core_clock_start();
+
+    /* FPU initialization */
+    SCB->CPACR |= ((3 << 10 * 2) | (3 << 11 * 2));
+}
+
+void core_clock_start(void)
+{
+    /* Start HSE and wait for it to be ready */
+    RCC->CR |= RCC_CR_HSEON;
+    while(!(RCC->CR & RCC_CR_HSERDY))
+        ;
+
     RCC->CR |= RCC_CR_PLLON;
     while(!(RCC->CR & RCC_CR_PLLRDY))
         ;
 
-    /* PLL as core source clock, prescaler 1 for APB2, prescaler 2 for APB1 */
-    RCC->CFGR |= RCC_CFGR_PPRE1_DIV4 | RCC_CFGR_PPRE2_DIV2 | RCC_CFGR_SW_PLL;
+    /* PLL as core source clock */
+    RCC->CFGR |= RCC_CFGR_SW_PLL;
     while(!(RCC->CFGR & RCC_CFGR_SWS_PLL))
         ;
-
-    /* FPU initialization */
-    SCB->CPACR |= ((3 << 10 * 2) | (3 << 11 * 2));
 }
 
 /**
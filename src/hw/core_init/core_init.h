@@ -23,6 +23,14 @@
  */
 void core_init(void);
 
+/**
+ * @brief Start HSE and PLL and switch core clock to PLL.
+ *
+ * Called by core_init() and after wakeup from STOP mode, which leaves
+ * the core running from HSI with HSE and PLL stopped.
+ */
+void core_clock_start(void);
+
 /**
  * @}
  */
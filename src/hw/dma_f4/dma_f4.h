@@ -0,0 +1,73 @@
+/**
+ * @file dma_f4.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief DMA register fields definitions shared by drivers
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _DMA_F4_H_
+#define _DMA_F4_H_
+
+#include "platform_specific.h"
+
+/**
+ * @defgroup hw_dma
+ * @{
+ */
+
+/** DMA Channel 0 */
+#define DMA_CHANNEL_0 0
+/** DMA Channel 1 */
+#define DMA_CHANNEL_1 1
+/** DMA Channel 2 */
+#define DMA_CHANNEL_2 2
+/** DMA Channel 3 */
+#define DMA_CHANNEL_3 3
+/** DMA Channel 4 */
+#define DMA_CHANNEL_4 4
+/** DMA Channel 5 */
+#define DMA_CHANNEL_5 5
+/** DMA Channel 6 */
+#define DMA_CHANNEL_6 6
+
+/** Value of PRIO field in DMA CR register - Priority low. */
+#define DMA_PRIO_LOW 0
+/** Value of PRIO field in DMA CR register - Priority medium. */
+#define DMA_PRIO_MEDIUM 1
+/** Value of PRIO field in DMA CR register - Priority high. */
+#define DMA_PRIO_HIGH 2
+/** Value of PRIO field in DMA CR register - Priority very high. */
+#define DMA_PRIO_VERYHIGH 3
+
+/** Value of PSIZE and MSIZE fields in DMA CR register - Size 8-bit. */
+#define DMA_SIZE_8BIT 0
+/** Value of PSIZE and MSIZE fields in DMA CR register - Size 16-bit. */
+#define DMA_SIZE_16BIT 1
+/** Value of PSIZE and MSIZE fields in DMA CR register - Size 32-bit. */
+#define DMA_SIZE_32BIT 2
+
+/** Value of DIR filed in DMA CR register - Direction peripheral to memory. */
+#define DMA_DIR_PERIPH_TO_MEM 0
+/** Value of DIR filed in DMA CR register - Direction memory to peripheral. */
+#define DMA_DIR_MEM_TO_PERIPH 1
+/** Value of DIR filed in DMA CR register - Direction memory to memory. */
+#define DMA_DIR_MEM_TO_MEM 2
+
+/** Offset of bitfield CHSEL in DMA CR register. */
+#define DMA_CR_CHSEL_BIT 25
+/** Offset of bitfield PL in DMA CR register. */
+#define DMA_CR_PL_BIT 16
+/** Offset of bitfield MSIZE in DMA CR register. */
+#define DMA_CR_MSIZE_BIT 13
+/** Offset of bitfield PSIZE in DMA CR register. */
+#define DMA_CR_PSIZE_BIT 11
+/** Offset of bitfield DIR in DMA CR register. */
+#define DMA_CR_DIR_BIT 6
+
+/**
+ * @}
+ */
+
+#endif /* _DMA_F4_H_ */
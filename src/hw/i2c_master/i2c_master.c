@@ -9,29 +9,21 @@
  */
 
 #include "i2c_master.h"
+#include "cpu_stats.h"
+#include "dma_f4.h"
 #include "gpio_f4.h"
 #include "platform_specific.h"
 
-/** DMA Channel 1 */
-#define DMA_CHANNEL_1 1
-/** DMA Channel 2 */
-#define DMA_CHANNEL_2 2
-/** DMA Channel 3 */
-#define DMA_CHANNEL_3 3
-/** DMA Channel 4 */
-#define DMA_CHANNEL_4 4
-/** DMA Channel 5 */
-#define DMA_CHANNEL_5 5
-/** DMA Channel 6 */
-#define DMA_CHANNEL_6 6
-
 /** I2C SCL pin number - PB06. */
 #define I2C_SCL_PIN 6
 /** O2C SDA pin number - PB07. */
 #define I2C_SDA_PIN 7
 
-/** DMA stream used for I2C Tx. */
-#define I2C_TX_DMA DMA1_Stream6
+/** DMA stream used for I2C Tx - DMA1 Stream7 Channel 1, Stream6 is used by USART2 Tx. */
+#define I2C_TX_DMA DMA1_Stream7
+
+/** DMA stream used for I2C Rx - DMA1 Stream0 Channel 1, Stream5 is used by USART2 Rx. */
+#define I2C_RX_DMA DMA1_Stream0
 
 /** Macro for calculating period in ns for a given frequency. */
 #define PERIOD_NS(freq_hz) (1000000000ULL / (freq_hz))
@@ -39,43 +31,24 @@
 /** Macro for calculating CCR value in 16/9 mode. */
 #define I2C_CCR_16_9_VAL(i2c_freq, pb_freq) (PERIOD_NS(i2c_freq) / (25 * PERIOD_NS(pb_freq)))
 
+/** Max number of loops waiting for the previous stop condition before the next start. */
+#define I2C_STOP_WAIT_LOOPS 1000
+
+/** Time to wait for transfer of n bytes in ms, 9 bit times per byte at 400 kHz plus margin. */
+#define I2C_TRANSFER_TIMEOUT(n_bytes) (10 + ((n_bytes) * 9) / 400)
+
+/** Max number of SCL pulses needed by slave to finish byte holding SDA low. */
+#define I2C_RECOVERY_CLOCKS 9
+
+/** Busy loops per half of recovery SCL period, about 100 kHz at 84 MHz core. */
+#define I2C_RECOVERY_HALF_PERIOD_LOOPS 100
+
+/** SR1 error flags handled by error interrupt. */
+#define I2C_SR1_ERRORS (I2C_SR1_AF | I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_OVR)
+
 /** Macro for calculating TRISE value. */
 #define I2C_TRISE_VAL(i2c_freq, pb_freq) (((PERIOD_NS(i2c_freq) / 10) / PERIOD_NS(pb_freq)) + 1)
 
-/** Value of PRIO field in DMA CR register - Priority low. */
-#define DMA_PRIO_LOW 0
-/** Value of PRIO field in DMA CR register - Priority medium. */
-#define DMA_PRIO_MEDIUM 1
-/** Value of PRIO field in DMA CR register - Priority high. */
-#define DMA_PRIO_HIGH 2
-/** Value of PRIO field in DMA CR register - Priority very high. */
-#define DMA_PRIO_VERYHIGH 3
-
-/** Value of PSIZE and MSIZE fields in DMA CR register - Size 8-bit. */
-#define DMA_SIZE_8BIT 0
-/** Value of PSIZE and MSIZE fields in DMA CR register - Size 16-bit. */
-#define DMA_SIZE_16BIT 1
-/** Value of PSIZE and MSIZE fields in DMA CR register - Size 32-bit. */
-#define DMA_SIZE_32BIT 2
-
-/** Value of DIR filed in DMA CR register - Direction peripheral to memory. */
-#define DMA_DIR_PERIPH_TO_MEM 0
-/** Value of DIR filed in DMA CR register - Direction memory to peripheral. */
-#define DMA_DIR_MEM_TO_PERIPH 1
-/** Value of DIR filed in DMA CR register - Direction memory to memory. */
-#define DMA_DIR_MEM_TO_MEM 2
-
-/** Offset of bitfield CHSEL in DMA CR register. */
-#define DMA_CR_CHSEL_BIT 25
-/** Offset of bitfield PL in DMA CR register. */
-#define DMA_CR_PL_BIT 16
-/** Offset of bitfield MSIZE in DMA CR register. */
-#define DMA_CR_MSIZE_BIT 13
-/** Offset of bitfield PSIZE in DMA CR register. */
-#define DMA_CR_PSIZE_BIT 11
-/** Offset of bitfield DIR in DMA CR register. */
-#define DMA_CR_DIR_BIT 6
-
 /**
  * Possible states of I2C driver
  */
@@ -83,6 +56,7 @@ enum i2c_state
 {
     I2C_IDLE, /**< No transfer in progress */
     I2C_TX,   /**< Tx transfer in progress */
+    I2C_RX,   /**< Rx transfer in progress, after start or repeated start */
 };
 
 /**
@@ -90,9 +64,12 @@ enum i2c_state
  */
 struct i2c_params
 {
-    uint8_t slave_addr;   /**< I2C slave address */
-    enum i2c_state state; /**< Internal state of the I2C driver */
-    void* sem;            /**< Semaphore guarding access to the peripheral */
+    uint8_t slave_addr;        /**< I2C slave address of the active transfer */
+    enum i2c_state state;      /**< Internal state of the I2C driver */
+    struct i2c_transfer* head; /**< Active transfer, first in the queue */
+    struct i2c_transfer* tail; /**< Last queued transfer */
+    bool recover;              /**< Bus recovery needed before the next transfer */
+    bool recovering;           /**< Bus recovery run by one of the tasks */
 };
 
 /**
@@ -123,51 +100,260 @@ static void dma_init(void);
  */
 static void dma_request_tx(uint8_t* data, int32_t n_bytes);
 
+/**
+ * DMA request for receiving data from I2C slave.
+ *
+ * @param data          Buffer for received data.
+ * @param n_bytes       Number of bytes to receive.
+ */
+static void dma_request_rx(uint8_t* data, int32_t n_bytes);
+
+/**
+ * Submit transfer and wait for its end.
+ *
+ * @param transfer      Transfer descriptor.
+ *
+ * @return              Error code.
+ */
+static int32_t i2c_transfer_sync(struct i2c_transfer* transfer);
+
+/**
+ * Start transfer at the head of the queue.
+ *
+ * Called with I2C interrupts masked, from critical section or from I2C interrupt.
+ * When bus recovery is pending the transfer is left queued and tasks waiting
+ * for queued transfers are notified to run i2c_recover_run().
+ *
+ * @param yield         Flag indicating if context switch is needed, may be NULL.
+ */
+static void i2c_start(int32_t* yield);
+
+/**
+ * Recover the bus if needed and start the queued transfer, called from task.
+ *
+ * Recovery busy waits for tens of us, so it is kept out of interrupts and
+ * critical sections. Only one task runs it, others return immediately.
+ */
+static void i2c_recover_run(void);
+
+/**
+ * Stop DMA streams and I2C interrupts of the active transfer, send stop.
+ */
+static void i2c_halt(void);
+
+/**
+ * Free the bus held by slave and reset the peripheral.
+ *
+ * SCL is clocked as GPIO until slave releases SDA, then stop is generated.
+ */
+static void i2c_bus_recover(void);
+
+/**
+ * Busy wait for half of recovery SCL period.
+ */
+static void i2c_recovery_delay(void);
+
+/**
+ * Finish active transfer and start the next one.
+ *
+ * @param status        Status of the active transfer.
+ * @param yield         Flag indicating if context switch is needed.
+ */
+static void i2c_complete_isr(int32_t status, int32_t* yield);
+
 void i2c_master_init(void)
 {
-    params.sem = rtos_sem_bin_create();
-    rtos_sem_give(params.sem);
     params.state = I2C_IDLE;
+    params.head = NULL;
+    params.tail = NULL;
+    params.recover = false;
+    params.recovering = false;
 
     gpio_init();
     i2c_init();
     dma_init();
 }
 
-int32_t i2c_master_write(uint8_t* data, uint8_t slave_addr, int32_t n_bytes)
+int32_t i2c_master_submit(struct i2c_transfer* transfer)
 {
-    if((data == NULL) || (n_bytes < 1))
+    if((transfer == NULL) || (transfer->tx_len < 0) || (transfer->rx_len < 0) || ((transfer->tx_len + transfer->rx_len) == 0) ||
+       ((transfer->tx_len > 0) && (transfer->tx_data == NULL)) || ((transfer->rx_len > 0) && (transfer->rx_data == NULL)))
     {
         /* Invalid arguments */
         return -EINVAL;
     }
 
-    if(rtos_sem_take(params.sem, 10) != true)
+    transfer->status = -EINPROGRESS;
+    transfer->next = NULL;
+
+    rtos_critical_section_enter();
+
+    if(params.head == NULL)
+    {
+        params.head = transfer;
+        params.tail = transfer;
+        i2c_start(NULL);
+    }
+    else
     {
-        /* Report timeout */
-        return -EBUSY;
+        params.tail->next = transfer;
+        params.tail = transfer;
     }
 
-    dma_request_tx(data, n_bytes);
-    params.slave_addr = (slave_addr << 1);
-    params.state = I2C_TX;
+    rtos_critical_section_exit();
 
-    /* Enable I2C event interrupt */
-    I2C1->CR2 |= I2C_CR2_ITEVTEN;
+    i2c_recover_run();
 
-    /* Send start signal */
-    I2C1->CR1 |= I2C_CR1_START;
+    return 0;
+}
 
-    if(rtos_sem_take(params.sem, 10) != true)
+int32_t i2c_master_wait(struct i2c_transfer* transfer, uint32_t ms)
+{
+    tick_t start = rtos_tick_count_get();
+    uint32_t others = 0;
+    uint32_t bits;
+
+    /* Any notification of the task ends the wait, so status decides */
+    while(transfer->status == -EINPROGRESS)
     {
-        /* Report timeout */
-        return -EBUSY;
+        uint32_t elapsed_ms = (rtos_tick_count_get() - start) * portTICK_RATE_MS;
+
+        if(elapsed_ms >= ms)
+        {
+            i2c_master_abort(transfer);
+            break;
+        }
+
+        bits = 0;
+        rtos_task_notify_bits_wait_clear(&bits, I2C_NOTIFY_BIT, ms - elapsed_ms);
+        others |= bits & ~I2C_NOTIFY_BIT;
+
+        /* Woken also when queue is held by pending bus recovery */
+        i2c_recover_run();
     }
 
-    rtos_sem_give(params.sem);
-    params.state = I2C_IDLE;
+    /* Abort could have left the bus for recovery with other transfers queued */
+    i2c_recover_run();
 
-    return 0;
+    /* Drop bit of transfer finished just before abort or left by earlier wakeup */
+    bits = 0;
+    rtos_task_notify_bits_wait_clear(&bits, I2C_NOTIFY_BIT, 0);
+    others |= bits & ~I2C_NOTIFY_BIT;
+
+    if(others != 0)
+    {
+        /* Notifications for the task were consumed by the wait, make them pending again */
+        rtos_task_notify_bits(rtos_task_current(), 0);
+    }
+
+    return transfer->status;
+}
+
+void i2c_master_abort(struct i2c_transfer* transfer)
+{
+    rtos_critical_section_enter();
+
+    if(transfer->status != -EINPROGRESS)
+    {
+        /* Already finished */
+    }
+    else if(transfer == params.head)
+    {
+        if(params.state != I2C_IDLE)
+        {
+            i2c_halt();
+
+            /* Transfer without any event or error means the bus is stuck */
+            params.recover = true;
+        }
+
+        transfer->status = -ETIMEDOUT;
+        params.head = transfer->next;
+        params.state = I2C_IDLE;
+
+        if(params.head != NULL)
+        {
+            i2c_start(NULL);
+        }
+    }
+    else
+    {
+        /* Unlink waiting transfer */
+        for(struct i2c_transfer* prev = params.head; prev != NULL; prev = prev->next)
+        {
+            if(prev->next == transfer)
+            {
+                prev->next = transfer->next;
+
+                if(params.tail == transfer)
+                {
+                    params.tail = prev;
+                }
+
+                transfer->status = -ETIMEDOUT;
+                break;
+            }
+        }
+    }
+
+    rtos_critical_section_exit();
+
+    /* Queue may hold only callback transfers, with no task waiting to recover the bus */
+    i2c_recover_run();
+}
+
+bool i2c_master_idle(void)
+{
+    return params.head == NULL;
+}
+
+static int32_t i2c_transfer_sync(struct i2c_transfer* transfer)
+{
+    transfer->notify_task = rtos_task_current();
+
+    int32_t ret = i2c_master_submit(transfer);
+
+    if(ret != 0)
+    {
+        return ret;
+    }
+
+    return i2c_master_wait(transfer, I2C_TRANSFER_TIMEOUT(transfer->tx_len + transfer->rx_len));
+}
+
+int32_t i2c_master_write(uint8_t* data, uint8_t slave_addr, int32_t n_bytes)
+{
+    struct i2c_transfer transfer = {
+        .slave_addr = slave_addr,
+        .tx_data = data,
+        .tx_len = n_bytes,
+    };
+
+    return i2c_transfer_sync(&transfer);
+}
+
+int32_t i2c_master_read(uint8_t* data, uint8_t slave_addr, int32_t n_bytes)
+{
+    struct i2c_transfer transfer = {
+        .slave_addr = slave_addr,
+        .rx_data = data,
+        .rx_len = n_bytes,
+    };
+
+    return i2c_transfer_sync(&transfer);
+}
+
+int32_t i2c_master_write_read(uint8_t* tx_data, int32_t n_tx, uint8_t* rx_data, int32_t n_rx, uint8_t slave_addr)
+{
+    struct i2c_transfer transfer = {
+        .slave_addr = slave_addr,
+        .tx_data = tx_data,
+        .tx_len = n_tx,
+        .rx_data = rx_data,
+        .rx_len = n_rx,
+    };
+
+    return i2c_transfer_sync(&transfer);
 }
 
 static void gpio_init(void)
@@ -177,6 +363,9 @@ static void gpio_init(void)
     gpio_mode_config(GPIOB, I2C_SCL_PIN, GPIO_MODE_AF);
     gpio_mode_config(GPIOB, I2C_SDA_PIN, GPIO_MODE_AF);
 
+    gpio_otype_od_set(GPIOB, I2C_SCL_PIN);
+    gpio_otype_od_set(GPIOB, I2C_SDA_PIN);
+
     gpio_af_config(GPIOB, I2C_SCL_PIN, GPIO_AF_I2C1);
     gpio_af_config(GPIOB, I2C_SDA_PIN, GPIO_AF_I2C1);
 }
@@ -192,18 +381,24 @@ static void i2c_init(void)
     I2C1->TRISE = I2C_TRISE_VAL(400000UL, APB1_CLOCK_FREQ);
 
     I2C1->CR1 = I2C_CR1_PE;
-    I2C1->CR2 |= I2C_CR2_DMAEN;
+    I2C1->CR2 |= I2C_CR2_DMAEN | I2C_CR2_ITERREN;
 
     NVIC_SetPriority(I2C1_EV_IRQn, I2C1_EV_PRIORITY);
     NVIC_EnableIRQ(I2C1_EV_IRQn);
+
+    NVIC_SetPriority(I2C1_ER_IRQn, I2C1_ER_PRIORITY);
+    NVIC_EnableIRQ(I2C1_ER_IRQn);
 }
 
 static void dma_init(void)
 {
     RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
 
-    NVIC_SetPriority(DMA1_Stream6_IRQn, DMA_I2C_TX_PRIORITY);
-    NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+    NVIC_SetPriority(DMA1_Stream7_IRQn, DMA_I2C_TX_PRIORITY);
+    NVIC_EnableIRQ(DMA1_Stream7_IRQn);
+
+    NVIC_SetPriority(DMA1_Stream0_IRQn, DMA_I2C_RX_PRIORITY);
+    NVIC_EnableIRQ(DMA1_Stream0_IRQn);
 }
 
 static void dma_request_tx(uint8_t* data, int32_t n_bytes)
@@ -221,43 +416,254 @@ static void dma_request_tx(uint8_t* data, int32_t n_bytes)
     I2C_TX_DMA->NDTR = n_bytes;
 }
 
+static void dma_request_rx(uint8_t* data, int32_t n_bytes)
+{
+    I2C_RX_DMA->CR = (1 << DMA_CR_CHSEL_BIT) |      /* Set channel 1 */
+        (DMA_PRIO_HIGH << DMA_CR_PL_BIT) |          /* Priority set to high */
+        (DMA_SIZE_8BIT << DMA_CR_MSIZE_BIT) |       /* Set memory size */
+        (DMA_SIZE_8BIT << DMA_CR_PSIZE_BIT) |       /* Set peripheral size */
+        DMA_SxCR_MINC |                             /* Memory increment */
+        (DMA_DIR_PERIPH_TO_MEM << DMA_CR_DIR_BIT) | /* Set direction */
+        DMA_SxCR_TCIE;                              /* Transfer complete IRQ */
+
+    I2C_RX_DMA->PAR = (uint32_t)&I2C1->DR;
+    I2C_RX_DMA->M0AR = (uint32_t)data;
+    I2C_RX_DMA->NDTR = n_bytes;
+}
+
+static void i2c_start(int32_t* yield)
+{
+    struct i2c_transfer* transfer = params.head;
+
+    if(params.recover)
+    {
+        /* Head stays queued in I2C_IDLE state until a task recovers the bus */
+        for(struct i2c_transfer* queued = params.head; queued != NULL; queued = queued->next)
+        {
+            if(queued->notify_task != NULL)
+            {
+                rtos_task_notify_bits_isr(queued->notify_task, I2C_NOTIFY_BIT, yield);
+            }
+        }
+
+        return;
+    }
+
+    /* Start set while the previous stop is pending would be lost */
+    for(uint32_t i = 0; ((I2C1->CR1 & I2C_CR1_STOP) != 0) && (i < I2C_STOP_WAIT_LOOPS); i++)
+    {}
+
+    params.slave_addr = (transfer->slave_addr << 1);
+    params.state = (transfer->tx_len > 0) ? I2C_TX : I2C_RX;
+
+    /* Enable I2C event interrupt */
+    I2C1->CR2 |= I2C_CR2_ITEVTEN;
+
+    /* Send start signal */
+    I2C1->CR1 |= I2C_CR1_START;
+}
+
+static void i2c_recover_run(void)
+{
+    bool run;
+
+    rtos_critical_section_enter();
+
+    run = params.recover && !params.recovering;
+
+    if(run)
+    {
+        /* recover stays set, so transfers submitted meanwhile wait in the queue */
+        params.recovering = true;
+    }
+
+    rtos_critical_section_exit();
+
+    if(!run)
+    {
+        return;
+    }
+
+    i2c_bus_recover();
+
+    rtos_critical_section_enter();
+
+    params.recover = false;
+    params.recovering = false;
+
+    if(params.head != NULL)
+    {
+        i2c_start(NULL);
+    }
+
+    rtos_critical_section_exit();
+}
+
+static void i2c_halt(void)
+{
+    I2C1->CR2 &= ~(I2C_CR2_ITEVTEN | I2C_CR2_LAST);
+    I2C_TX_DMA->CR &= ~(DMA_SxCR_EN);
+    I2C_RX_DMA->CR &= ~(DMA_SxCR_EN);
+    DMA1->HIFCR = DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7;
+    DMA1->LIFCR = DMA_LIFCR_CTCIF0 | DMA_LIFCR_CHTIF0 | DMA_LIFCR_CTEIF0 | DMA_LIFCR_CDMEIF0 | DMA_LIFCR_CFEIF0;
+    I2C1->CR1 = (I2C1->CR1 & ~(I2C_CR1_ACK | I2C_CR1_POS)) | I2C_CR1_STOP;
+}
+
+static void i2c_recovery_delay(void)
+{
+    for(volatile uint32_t i = 0; i < I2C_RECOVERY_HALF_PERIOD_LOOPS; i++)
+    {}
+}
+
+static void i2c_bus_recover(void)
+{
+    I2C1->CR1 &= ~I2C_CR1_PE;
+
+    /* Drive pins as open drain GPIO, both released */
+    GPIOB->BSRRL = (1 << I2C_SCL_PIN) | (1 << I2C_SDA_PIN);
+    gpio_mode_config(GPIOB, I2C_SCL_PIN, GPIO_MODE_OUTPUT);
+    gpio_mode_config(GPIOB, I2C_SDA_PIN, GPIO_MODE_OUTPUT);
+    i2c_recovery_delay();
+
+    /* Clock out byte of slave holding SDA low */
+    for(uint32_t i = 0; (i < I2C_RECOVERY_CLOCKS) && ((GPIOB->IDR & (1 << I2C_SDA_PIN)) == 0); i++)
+    {
+        GPIOB->BSRRH = (1 << I2C_SCL_PIN);
+        i2c_recovery_delay();
+        GPIOB->BSRRL = (1 << I2C_SCL_PIN);
+        i2c_recovery_delay();
+    }
+
+    /* Stop condition, SDA rises while SCL is high */
+    GPIOB->BSRRH = (1 << I2C_SCL_PIN);
+    i2c_recovery_delay();
+    GPIOB->BSRRH = (1 << I2C_SDA_PIN);
+    i2c_recovery_delay();
+    GPIOB->BSRRL = (1 << I2C_SCL_PIN);
+    i2c_recovery_delay();
+    GPIOB->BSRRL = (1 << I2C_SDA_PIN);
+    i2c_recovery_delay();
+
+    gpio_mode_config(GPIOB, I2C_SCL_PIN, GPIO_MODE_AF);
+    gpio_mode_config(GPIOB, I2C_SDA_PIN, GPIO_MODE_AF);
+
+    /* Software reset clears BUSY flag latched by bus glitches */
+    I2C1->CR1 |= I2C_CR1_SWRST;
+    I2C1->CR1 &= ~I2C_CR1_SWRST;
+
+    i2c_init();
+}
+
+static void i2c_complete_isr(int32_t status, int32_t* yield)
+{
+    struct i2c_transfer* transfer = params.head;
+
+    params.head = transfer->next;
+    params.state = I2C_IDLE;
+
+    /* Next transfer starts right after the stop, before client is informed */
+    if(params.head != NULL)
+    {
+        i2c_start(yield);
+    }
+
+    transfer->status = status;
+
+    if(transfer->notify_task != NULL)
+    {
+        rtos_task_notify_bits_isr(transfer->notify_task, I2C_NOTIFY_BIT, yield);
+    }
+
+    if(transfer->callback != NULL)
+    {
+        transfer->callback(transfer, yield);
+    }
+}
+
 void I2C1_EV_IRQHandler(void)
 {
+    uint32_t start = cpu_stats_isr_enter(CPU_STATS_ISR_I2C_EV);
     int32_t yield = 0;
     uint32_t sr1;
     volatile uint32_t dummy;
+    struct i2c_transfer* transfer = params.head;
 
     sr1 = I2C1->SR1;
 
     /* Check for the end of start event */
     if((sr1 & I2C_SR1_SB) != 0)
     {
-        I2C1->DR = params.slave_addr;
+        /* Read direction bit is set for rx, also after repeated start */
+        I2C1->DR = params.slave_addr | ((params.state == I2C_RX) ? 1 : 0);
     }
     else if((sr1 & I2C_SR1_ADDR) != 0)
     {
+        /* Disable I2C1 event interrupt during DMA transfer */
+        I2C1->CR2 &= ~I2C_CR2_ITEVTEN;
+
+        if(params.state == I2C_TX)
+        {
+            /* Start TX DMA */
+            dma_request_tx(transfer->tx_data, transfer->tx_len);
+            I2C_TX_DMA->CR |= DMA_SxCR_EN;
+        }
+        else
+        {
+            /* Start RX DMA */
+            dma_request_rx(transfer->rx_data, transfer->rx_len);
+            I2C_RX_DMA->CR |= DMA_SxCR_EN;
+
+            if(transfer->rx_len == 1)
+            {
+                /* NACK has to be set before ADDR is cleared */
+                I2C1->CR1 &= ~I2C_CR1_ACK;
+            }
+            else if(transfer->rx_len == 2)
+            {
+                /* NACK is applied to the second byte */
+                I2C1->CR1 = (I2C1->CR1 & ~I2C_CR1_ACK) | I2C_CR1_POS;
+                I2C1->CR2 |= I2C_CR2_LAST;
+            }
+            else
+            {
+                /* DMA end of the last but one byte makes I2C send NACK after the last one */
+                I2C1->CR1 |= I2C_CR1_ACK;
+                I2C1->CR2 |= I2C_CR2_LAST;
+            }
+        }
+
         /* Clear the ADDR flag by reading SR1 and SR2 registers */
         dummy = I2C1->SR1;
         dummy = I2C1->SR2;
         /* Prevent compiler warnings about unused variable */
         (void)dummy;
-        /* Disable I2C1 event interrupt during DMA transfer */
-        I2C1->CR2 &= ~I2C_CR2_ITEVTEN;
 
-        /* Start TX DMA */
-        I2C_TX_DMA->CR |= DMA_SxCR_EN;
+        if((params.state == I2C_RX) && (transfer->rx_len == 1))
+        {
+            /* Stop right after ADDR is cleared, so it follows the only byte */
+            I2C1->CR1 |= I2C_CR1_STOP;
+        }
     }
     else if((sr1 & I2C_SR1_BTF) != 0)
     {
         if(params.state == I2C_TX)
         {
-            /* Disable I2C1 event interrupt as it is the end of the tx */
-            I2C1->CR2 &= ~I2C_CR2_ITEVTEN;
-
-            /* Send stop signal */
-            I2C1->CR1 |= I2C_CR1_STOP;
-
-            rtos_sem_give_isr(params.sem, &yield);
+            if(transfer->rx_len > 0)
+            {
+                /* Repeated start, event interrupt stays enabled for SB */
+                params.state = I2C_RX;
+                I2C1->CR1 |= I2C_CR1_START;
+            }
+            else
+            {
+                /* Disable I2C1 event interrupt as it is the end of the tx */
+                I2C1->CR2 &= ~I2C_CR2_ITEVTEN;
+
+                /* Send stop signal */
+                I2C1->CR1 |= I2C_CR1_STOP;
+
+                i2c_complete_isr(0, &yield);
+            }
         }
         else
         {}
@@ -265,18 +671,97 @@ void I2C1_EV_IRQHandler(void)
     else
     {}
 
+    cpu_stats_isr_exit(CPU_STATS_ISR_I2C_EV, start);
     portYIELD_FROM_ISR(yield);
 }
 
-void DMA1_Stream6_IRQHandler(void)
+void DMA1_Stream7_IRQHandler(void)
 {
-    if((DMA1->HISR & DMA_HISR_TCIF6) != 0)
+    uint32_t start = cpu_stats_isr_enter(CPU_STATS_ISR_I2C_TX_DMA);
+
+    if((DMA1->HISR & DMA_HISR_TCIF7) != 0)
     {
         /* Clear transfer complete flag and DMA enable flag */
-        DMA1->HIFCR |= DMA_HIFCR_CTCIF6;
+        DMA1->HIFCR |= DMA_HIFCR_CTCIF7;
         I2C_TX_DMA->CR &= ~(DMA_SxCR_EN);
 
         /* Enable I2C event interrupt to check for BTF */
         I2C1->CR2 |= I2C_CR2_ITEVTEN;
     }
+
+    cpu_stats_isr_exit(CPU_STATS_ISR_I2C_TX_DMA, start);
+}
+
+void DMA1_Stream0_IRQHandler(void)
+{
+    uint32_t start = cpu_stats_isr_enter(CPU_STATS_ISR_I2C_RX_DMA);
+    int32_t yield = 0;
+
+    if((DMA1->LISR & DMA_LISR_TCIF0) != 0)
+    {
+        /* Clear transfer complete flag and DMA enable flag */
+        DMA1->LIFCR |= DMA_LIFCR_CTCIF0;
+        I2C_RX_DMA->CR &= ~(DMA_SxCR_EN);
+
+        I2C1->CR2 &= ~I2C_CR2_LAST;
+
+        /* Single byte read has stop already sent */
+        if(params.head->rx_len > 1)
+        {
+            I2C1->CR1 |= I2C_CR1_STOP;
+        }
+
+        I2C1->CR1 &= ~(I2C_CR1_ACK | I2C_CR1_POS);
+
+        i2c_complete_isr(0, &yield);
+    }
+
+    cpu_stats_isr_exit(CPU_STATS_ISR_I2C_RX_DMA, start);
+    portYIELD_FROM_ISR(yield);
+}
+
+void I2C1_ER_IRQHandler(void)
+{
+    uint32_t start = cpu_stats_isr_enter(CPU_STATS_ISR_I2C_ER);
+    int32_t yield = 0;
+    int32_t status;
+    uint32_t sr1 = I2C1->SR1;
+
+    /* Error flags are cleared by writing 0 */
+    I2C1->SR1 = ~(sr1 & I2C_SR1_ERRORS) & 0xFFFF;
+
+    if((sr1 & I2C_SR1_AF) != 0)
+    {
+        /* Slave didn't acknowledge, e.g. device is disconnected */
+        status = -ENXIO;
+    }
+    else if((sr1 & I2C_SR1_ARLO) != 0)
+    {
+        /* Only master on the bus, lost arbitration means glitch on the lines */
+        status = -EAGAIN;
+        params.recover = true;
+    }
+    else if((sr1 & I2C_SR1_BERR) != 0)
+    {
+        /* Misplaced start or stop */
+        status = -EIO;
+        params.recover = true;
+    }
+    else if((sr1 & I2C_SR1_OVR) != 0)
+    {
+        status = -EIO;
+    }
+    else
+    {
+        status = 0;
+    }
+
+    if((status != 0) && (params.head != NULL))
+    {
+        i2c_halt();
+        i2c_complete_isr(status, &yield);
+    }
+
+    cpu_stats_isr_exit(CPU_STATS_ISR_I2C_ER, start);
+    portYIELD_FROM_ISR(yield);
 }
@@ -14,6 +14,44 @@
 
 #include "platform_specific.h"
 
+struct i2c_transfer;
+
+/**
+ * Notification bit set in notify_task on completion, reserved for the driver.
+ *
+ * Other bits and counts of the task notification value are left for the task.
+ */
+#define I2C_NOTIFY_BIT (1UL << 31)
+
+/**
+ * Transfer completion callback, called from interrupt.
+ *
+ * @param transfer      Finished transfer, status is already set.
+ * @param yield         Flag indicating if context switch is needed.
+ */
+typedef void (*i2c_callback_t)(struct i2c_transfer* transfer, int32_t* yield);
+
+/**
+ * I2C transaction descriptor.
+ *
+ * Descriptor and its buffers are owned by the driver from i2c_master_submit()
+ * until completion, transfers are executed in submission order. When both
+ * tx and rx are set, data is sent first and read after repeated start.
+ */
+struct i2c_transfer
+{
+    uint8_t slave_addr;        /**< 7-bit slave address */
+    uint8_t* tx_data;          /**< Data to send */
+    int32_t tx_len;            /**< Number of bytes to send, 0 for read only */
+    uint8_t* rx_data;          /**< Buffer for received data */
+    int32_t rx_len;            /**< Number of bytes to read, 0 for write only */
+    i2c_callback_t callback;   /**< Called from interrupt on completion, may be NULL */
+    void* notify_task;         /**< Task notified with I2C_NOTIFY_BIT on completion, may be NULL */
+    void* arg;                 /**< Client data, unused by driver */
+    volatile int32_t status;   /**< -EINPROGRESS until completion, then 0 or error code */
+    struct i2c_transfer* next; /**< Next queued transfer, used by driver */
+};
+
 /**
  * @brief initialization of i2c periphal as master
  *
@@ -21,13 +59,86 @@
 void i2c_master_init(void);
 
 /**
- * @brief i2c function
+ * @brief Queue transfer, it starts as soon as previous ones finish
+ *
+ * After bus errors the queue is held until the bus is recovered, which is
+ * done in task context by this function, i2c_master_wait() or
+ * i2c_master_abort(). Recovery is never run from interrupt, so when none of
+ * the queued transfers has notify_task set, the queue stays held until the
+ * next call of one of them, e.g. abort of a transfer whose callback didn't
+ * come in time.
+ *
+ * @param transfer      Transfer descriptor.
+ *
+ * @return              0 when queued, -EINVAL on invalid descriptor.
+ */
+int32_t i2c_master_submit(struct i2c_transfer* transfer);
+
+/**
+ * @brief Wait for the end of transfer submitted with notify_task set to calling task
+ *
+ * Transfer is aborted on timeout, so it is never left queued. Other
+ * notifications received meanwhile stay pending for the task.
+ *
+ * @param transfer      Transfer descriptor.
+ * @param ms            Time to wait in ms.
+ *
+ * @return              Transfer status, -ETIMEDOUT when aborted.
+ */
+int32_t i2c_master_wait(struct i2c_transfer* transfer, uint32_t ms);
+
+/**
+ * @brief Remove transfer from the queue, stop it if already started
+ *
+ * Callback and notification of aborted transfer are not called. Bus
+ * recovery left pending by errors or by this abort is run before return.
+ *
+ * @param transfer      Transfer descriptor.
+ */
+void i2c_master_abort(struct i2c_transfer* transfer);
+
+/**
+ * @brief Check if bus is free, used before entering STOP mode
+ *
+ * @return              true when no transfer is queued or in progress.
+ */
+bool i2c_master_idle(void);
+
+/**
+ * @brief Send data and wait for the end of the transfer
+ *
+ * @param data          Data to send.
+ * @param slave_addr    7-bit slave address.
+ * @param n_bytes       Number of bytes to send.
  *
- * @param data
- * @param slave_addr
- * @param n_bytes
- * @return int32_t
+ * @return              Error code.
  */
 int32_t i2c_master_write(uint8_t* data, uint8_t slave_addr, int32_t n_bytes);
 
+/**
+ * @brief Read data and wait for the end of the transfer
+ *
+ * @param data          Buffer for received data.
+ * @param slave_addr    7-bit slave address.
+ * @param n_bytes       Number of bytes to read.
+ *
+ * @return              Error code.
+ */
+int32_t i2c_master_read(uint8_t* data, uint8_t slave_addr, int32_t n_bytes);
+
+/**
+ * @brief Send data, read after repeated start and wait for the end of the transfer
+ *
+ * Typically register address is sent and register content is read.
+ *
+ * @param tx_data       Data to send.
+ * @param n_tx          Number of bytes to send.
+ * @param rx_data       Buffer for received data.
+ * @param n_rx          Number of bytes to read.
+ * @param slave_addr    7-bit slave address.
+ *
+ * @return              Error code.
+ */
+int32_t i2c_master_write_read(uint8_t* tx_data, int32_t n_tx, uint8_t* rx_data, int32_t n_rx, uint8_t slave_addr);
+
 #endif /* _I2C_MASTER_H_ */
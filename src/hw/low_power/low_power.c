@@ -0,0 +1,314 @@
+/**
+ * @file low_power.c
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Tickless idle with sleep and STOP mode
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "low_power.h"
+#include "battery.h"
+#include "button.h"
+#include "core_init.h"
+#include "cpu_stats.h"
+#include "i2c_master.h"
+#include "usart.h"
+
+/** RTC asynchronous prescaler, sub second counter and wakeup timer tick at LSI / 2. */
+#define RTC_PREDIV_A 1
+/** Wakeup timer clock RTC / 2, the same rate as sub second counter. */
+#define RTC_WUCKSEL_DIV2 (RTC_CR_WUCKSEL_0 | RTC_CR_WUCKSEL_1)
+/** RTC write protection keys. */
+#define RTC_WPR_KEY1 0xCA
+#define RTC_WPR_KEY2 0x53
+
+/** EXTI line connected to RTC wakeup event. */
+#define RTC_WAKEUP_EXTI_LINE (1 << 22)
+
+/** Clock of TIM5 used for LSI measurement, APB1 timers run at twice APB1 frequency. */
+#define LSI_TIM_CLOCK_FREQ (APB1_CLOCK_FREQ * 2)
+/** LSI periods in single TIM5 capture, input prescaler 8. */
+#define LSI_CAPTURE_PERIODS 8
+/** Captures averaged by LSI measurement, about 4 ms. */
+#define LSI_CAPTURES 16
+
+/** SysTick counts in single tick, the same as loaded by RTOS port. */
+#define SYSTICK_TICK_COUNTS (configCPU_CLOCK_HZ / configTICK_RATE_HZ)
+/** Shortest SysTick period after idle, zero reload stops the counter. */
+#define SYSTICK_MIN_COUNTS 100
+
+/** Longest idle in ticks, sub second counter wraps after 1 s. */
+#define LOW_POWER_MAX_IDLE_TICKS 500
+/** Shortest idle in ticks worth STOP mode, HSE and PLL start takes hundreds of us. */
+#define LOW_POWER_STOP_MIN_TICKS 5
+
+/** RTC counts per second, half of measured LSI frequency. */
+static uint32_t rtc_freq;
+
+/**
+ * Measure LSI frequency with TIM5 channel 4 input capture.
+ *
+ * @return              LSI frequency in Hz.
+ */
+static uint32_t lsi_freq_measure(void);
+
+/**
+ * Start RTC from LSI, sub second counter wraps every second.
+ */
+static void rtc_init(void);
+
+/**
+ * Read sub second counter.
+ *
+ * @return              Counter value, counts down from rtc_freq - 1.
+ */
+static uint32_t rtc_ssr_read(void);
+
+/**
+ * Start wakeup timer.
+ *
+ * @param counts        Time to wakeup in RTC counts.
+ */
+static void rtc_wakeup_start(uint32_t counts);
+
+/**
+ * Stop wakeup timer and drop its pending event.
+ */
+static void rtc_wakeup_stop(void);
+
+/**
+ * Check if peripherals can be stopped for idle time.
+ *
+ * DMA transfers, timers and USART don't work in STOP mode.
+ *
+ * @param idle          Expected idle time in ticks.
+ *
+ * @return              true when STOP mode can be used, false for sleep mode.
+ */
+static bool low_power_stop_allowed(TickType_t idle);
+
+void low_power_init(void)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+
+    /* LSI keeps running in STOP mode */
+    RCC->CSR |= RCC_CSR_LSION;
+    while(!(RCC->CSR & RCC_CSR_LSIRDY))
+        ;
+
+    rtc_freq = lsi_freq_measure() / (RTC_PREDIV_A + 1);
+    rtc_init();
+
+    /* Low power regulator and flash powered down in STOP mode */
+    PWR->CR |= PWR_CR_LPDS | PWR_CR_FPDS;
+
+    EXTI->IMR |= RTC_WAKEUP_EXTI_LINE;
+    EXTI->RTSR |= RTC_WAKEUP_EXTI_LINE;
+
+    NVIC_SetPriority(RTC_WKUP_IRQn, RTC_WAKEUP_PRIORITY);
+    NVIC_EnableIRQ(RTC_WKUP_IRQn);
+}
+
+static uint32_t lsi_freq_measure(void)
+{
+    RCC->APB1ENR |= RCC_APB1ENR_TIM5EN;
+
+    /* LSI connected to channel 4, captured every LSI_CAPTURE_PERIODS rising edges */
+    TIM5->OR = TIM_OR_TI4_RMP_0;
+    TIM5->PSC = 0;
+    TIM5->ARR = UINT32_MAX;
+    TIM5->CCMR2 = TIM_CCMR2_CC4S_0 | TIM_CCMR2_IC4PSC;
+    TIM5->CCER = TIM_CCER_CC4E;
+    TIM5->EGR = TIM_EGR_UG;
+    TIM5->SR = 0;
+    TIM5->CR1 = TIM_CR1_CEN;
+
+    uint32_t first = 0;
+    uint32_t last = 0;
+
+    for(uint32_t i = 0; i <= LSI_CAPTURES; i++)
+    {
+        while(!(TIM5->SR & TIM_SR_CC4IF))
+            ;
+
+        /* Reading capture clears the flag */
+        last = TIM5->CCR4;
+
+        if(i == 0)
+        {
+            first = last;
+        }
+    }
+
+    TIM5->CR1 = 0;
+    RCC->APB1ENR &= ~RCC_APB1ENR_TIM5EN;
+
+    return (LSI_TIM_CLOCK_FREQ * LSI_CAPTURES * LSI_CAPTURE_PERIODS) / (last - first);
+}
+
+static void rtc_init(void)
+{
+    /* Backup domain is write protected after reset */
+    PWR->CR |= PWR_CR_DBP;
+
+    if((RCC->BDCR & (RCC_BDCR_RTCSEL | RCC_BDCR_RTCEN)) != (RCC_BDCR_RTCSEL_1 | RCC_BDCR_RTCEN))
+    {
+        /* RTC clock source can be changed only by backup domain reset */
+        RCC->BDCR |= RCC_BDCR_BDRST;
+        RCC->BDCR &= ~RCC_BDCR_BDRST;
+        RCC->BDCR = RCC_BDCR_RTCSEL_1 | RCC_BDCR_RTCEN;
+    }
+
+    /* Registers stay unlocked, wakeup timer is reprogrammed on every idle */
+    RTC->WPR = RTC_WPR_KEY1;
+    RTC->WPR = RTC_WPR_KEY2;
+
+    RTC->ISR |= RTC_ISR_INIT;
+    while(!(RTC->ISR & RTC_ISR_INITF))
+        ;
+
+    /* Synchronous and asynchronous prescalers are written separately */
+    RTC->PRER = rtc_freq - 1;
+    RTC->PRER |= (RTC_PREDIV_A << 16);
+    RTC->ISR &= ~RTC_ISR_INIT;
+
+    /* Counter read directly, shadow registers need resync after STOP */
+    RTC->CR = RTC_CR_BYPSHAD;
+}
+
+static uint32_t rtc_ssr_read(void)
+{
+    uint32_t ssr;
+
+    /* Without shadow registers counter may change during read */
+    do
+    {
+        ssr = RTC->SSR;
+    } while(ssr != RTC->SSR);
+
+    return ssr;
+}
+
+static void rtc_wakeup_start(uint32_t counts)
+{
+    RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+    while(!(RTC->ISR & RTC_ISR_WUTWF))
+        ;
+
+    RTC->WUTR = counts - 1;
+    RTC->CR = (RTC->CR & ~RTC_CR_WUCKSEL) | RTC_WUCKSEL_DIV2;
+    RTC->ISR &= ~RTC_ISR_WUTF;
+    EXTI->PR = RTC_WAKEUP_EXTI_LINE;
+
+    RTC->CR |= RTC_CR_WUTE | RTC_CR_WUTIE;
+}
+
+static void rtc_wakeup_stop(void)
+{
+    RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+    RTC->ISR &= ~RTC_ISR_WUTF;
+    EXTI->PR = RTC_WAKEUP_EXTI_LINE;
+    NVIC_ClearPendingIRQ(RTC_WKUP_IRQn);
+}
+
+static bool low_power_stop_allowed(TickType_t idle)
+{
+    if(idle < LOW_POWER_STOP_MIN_TICKS)
+    {
+        return false;
+    }
+
+    return i2c_master_idle() && usart_idle() && button_idle() && battery_idle();
+}
+
+void vPortSuppressTicksAndSleep(TickType_t idle)
+{
+    if(idle > LOW_POWER_MAX_IDLE_TICKS)
+    {
+        idle = LOW_POWER_MAX_IDLE_TICKS;
+    }
+
+    /* Stopped SysTick keeps the part of current tick which already passed */
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+    uint32_t tick_counts = SysTick->LOAD - SysTick->VAL;
+
+    /* Interrupts still wake up the core, but run after clocks are restored */
+    __disable_irq();
+    __DSB();
+    __ISB();
+
+    if(eTaskConfirmSleepModeStatus() == eAbortSleep)
+    {
+        /* Task made ready by interrupt, finish current tick */
+        SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+        __enable_irq();
+        return;
+    }
+
+    bool stop = low_power_stop_allowed(idle);
+
+    /* Wake up just before the tick which unblocks a task, SysTick finishes it */
+    uint32_t sleep_counts = ((uint64_t)(idle * SYSTICK_TICK_COUNTS - tick_counts) * rtc_freq) / configCPU_CLOCK_HZ;
+    uint32_t ssr = rtc_ssr_read();
+    rtc_wakeup_start(sleep_counts);
+
+    if(stop)
+    {
+        usart_rx_wakeup_set(true);
+        SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    }
+
+    __DSB();
+    __WFI();
+    __ISB();
+
+    if(stop)
+    {
+        SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+        /* Core wakes up from HSI */
+        core_clock_start();
+        usart_rx_wakeup_set(false);
+    }
+
+    /* Sub second counter counts down and wraps every second */
+    uint32_t rtc_counts = (ssr + rtc_freq - rtc_ssr_read()) % rtc_freq;
+    uint32_t sleep_cycles = ((uint64_t)rtc_counts * configCPU_CLOCK_HZ) / rtc_freq;
+    rtc_wakeup_stop();
+
+    /* Idle task run time includes time with core clock stopped */
+    cpu_stats_sleep_add(sleep_cycles);
+
+    /* Time since the last tick interrupt in SysTick counts */
+    uint32_t elapsed = tick_counts + sleep_cycles;
+    uint32_t ticks = elapsed / SYSTICK_TICK_COUNTS;
+    uint32_t next_tick = SYSTICK_TICK_COUNTS - (elapsed % SYSTICK_TICK_COUNTS);
+
+    if(ticks >= idle)
+    {
+        /* Overslept, unblock the task with the next tick */
+        ticks = idle - 1;
+        next_tick = SYSTICK_MIN_COUNTS;
+    }
+    else if(next_tick < SYSTICK_MIN_COUNTS)
+    {
+        next_tick = SYSTICK_MIN_COUNTS;
+    }
+
+    vTaskStepTick(ticks);
+
+    /* Counter reloads from LOAD on the first clock after it is enabled */
+    SysTick->LOAD = next_tick - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = SYSTICK_TICK_COUNTS - 1;
+
+    __enable_irq();
+}
+
+void RTC_WKUP_IRQHandler(void)
+{
+    /* Event is consumed by idle task, only flags are left here */
+    RTC->ISR &= ~RTC_ISR_WUTF;
+    EXTI->PR = RTC_WAKEUP_EXTI_LINE;
+}
@@ -0,0 +1,27 @@
+/**
+ * @file low_power.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Tickless idle with sleep and STOP mode
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _LOW_POWER_H_
+#define _LOW_POWER_H_
+
+#include "platform_specific.h"
+
+/**
+ * Initialize timer used during tickless idle.
+ *
+ * SysTick doesn't run in STOP mode, so idle time is measured by RTC clocked
+ * from LSI, which keeps running. LSI frequency is measured against HSE with
+ * TIM5 once, because its tolerance is too wide to keep RTOS time.
+ *
+ * Idle task enters STOP mode when I2C, USART and button drivers are idle and
+ * sleep mode otherwise. Has to be called after core_init().
+ */
+void low_power_init(void);
+
+#endif /* _LOW_POWER_H_ */
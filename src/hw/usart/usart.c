@@ -14,32 +14,79 @@
  */
 
 #include "usart.h"
+#include "cpu_stats.h"
+#include "dma_f4.h"
 #include "gpio_f4.h"
+#include "latency_stats.h"
 #include "platform_specific.h"
+#include "ring_buf.h"
 
-/* queue for send data by USART */
-static queue_t tx_queue;
-/* length of tx queue */
-#define TX_QUEUE_LEN 32
+/** DMA stream used for USART Tx - DMA1 Stream6 Channel 4. */
+#define USART_TX_DMA DMA1_Stream6
 
-/* queue for receive data from USART */
-static queue_t rx_queue;
-/* length of rx queue */
-#define RX_QUEUE_LEN 32
+/** Time to wait for previous tx transfer in ms */
+#define USART_TX_TIMEOUT 10
 
-/** USART baud rate. */
+/* length of circular buffer filled by rx DMA, power of two */
+#define RX_DMA_BUF_LEN 256
+
+/* Fill level of rx buffer which wakes up reader before IDLE line */
+#define RX_NOTIFY_THRESHOLD (RX_DMA_BUF_LEN / 4)
+
+/* Number of remembered rx publications, power of two */
+#define RX_STAMPS 8
+
+/* storage of rx ring, written in place by circular DMA */
+static uint8_t rx_dma_buf[RX_DMA_BUF_LEN];
+/* rx ring, DMA interrupts produce and usart_read_buf consumes */
+static struct ring_buf rx_ring;
+
+/** DMA stream used for USART Rx - DMA1 Stream5 Channel 4. */
+#define USART_RX_DMA DMA1_Stream5
+
+/** USART baud rate after init. */
 #define USART_BAUD_RATE 9600
 
+/** Macro for calculating BRR value with 16x oversampling, rounded to nearest. */
+#define USART_BRR_VAL(pb_freq, baud) (((pb_freq) + ((baud) / 2)) / (baud))
+
 /** Pin number used for USART TX - PA09. */
 #define USART_TX_PIN 2
 /** Pin number used for USART RX - PA10. */
 #define USART_RX_PIN 3
 
-/** Mutex serialising access to USART tx. */
+/** Semaphore held by tx DMA transfer, given back on its completion. */
 static sem_t tx_sem_bin;
+/** Static memory of tx semaphore. */
+static sem_buf_t tx_sem_buf;
+
+/** Time without received bytes after which rx is silent and STOP mode is allowed, in ms. */
+#define USART_RX_QUIET_MS 1000
 
-/** Mutex serialising access to USART rx. */
-static sem_t rx_sem_bin;
+/** Tick of the last rx activity. */
+static volatile tick_t rx_last_tick;
+
+/**
+ * Publication of received bytes to rx ring.
+ */
+struct usart_rx_stamp
+{
+    uint32_t head; /**< Ring head after publication */
+    uint32_t time; /**< Cycle counter at publication */
+};
+
+/** Latest publications, written by rx interrupts, oldest overwritten. */
+static struct usart_rx_stamp rx_stamps[RX_STAMPS];
+/** Free running count of publications, interrupts only. */
+static volatile uint32_t rx_stamps_head;
+/** Free running count of publications read completely, reader only. */
+static uint32_t rx_stamps_tail;
+
+/** Number of rx DMA overruns, unread bytes overwritten by DMA. */
+static volatile uint32_t rx_overruns;
+
+/** Overruns already reported to the reader. */
+static uint32_t rx_overruns_seen;
 
 /**
  * @brief Initialization of USART gpio
@@ -53,17 +100,43 @@ static void gpio_init(void);
  */
 static void usart2_init(void);
 
+/**
+ * @brief Initialization of circular rx DMA
+ *
+ */
+static void dma_rx_init(void);
+
+/**
+ * @brief Initialization of tx DMA interrupt
+ *
+ */
+static void dma_tx_init(void);
+
+/**
+ * @brief Publish bytes written by rx DMA since last call to rx ring
+ *
+ * @param yield - set when context switch is needed
+ */
+static void dma_rx_commit_isr(int32_t* yield);
+
+/**
+ * @brief Find publication of the first unread byte
+ *
+ * Publications read completely are dropped.
+ *
+ * @param stamp - publication, its head ends bytes published together
+ * @return bool - false when no unread byte is published
+ */
+static bool usart_rx_stamp_get(struct usart_rx_stamp* stamp);
+
 void usart_init(void)
 {
-    tx_sem_bin = rtos_sem_bin_create();
-    rx_sem_bin = rtos_sem_bin_create();
+    tx_sem_bin = rtos_sem_bin_create_static(&tx_sem_buf);
     rtos_sem_give(tx_sem_bin);
-    rtos_sem_give(rx_sem_bin);
-
-    tx_queue = rtos_queue_create(TX_QUEUE_LEN, sizeof(uint8_t));
-    rx_queue = rtos_queue_create(RX_QUEUE_LEN, sizeof(uint8_t));
 
     gpio_init();
+    dma_rx_init();
+    dma_tx_init();
     usart2_init();
 }
 
@@ -75,49 +148,183 @@ int32_t usart_send_buf(uint8_t* buf, const int32_t n_bytes)
         return -EINVAL;
     }
 
-    if(rtos_sem_take(tx_sem_bin, 10) != true)
+    /* Previous buffer has to be sent before starting the new one */
+    if(rtos_sem_take(tx_sem_bin, USART_TX_TIMEOUT) != true)
+    {
+        /* Report timeout */
+        return -EBUSY;
+    }
+
+    USART_TX_DMA->CR = (DMA_CHANNEL_4 << DMA_CR_CHSEL_BIT) | /* Set channel 4 */
+        (DMA_PRIO_MEDIUM << DMA_CR_PL_BIT) |                 /* Priority set to medium */
+        (DMA_SIZE_8BIT << DMA_CR_MSIZE_BIT) |                /* Set memory size */
+        (DMA_SIZE_8BIT << DMA_CR_PSIZE_BIT) |                /* Set peripheral size */
+        DMA_SxCR_MINC |                                      /* Memory increment */
+        (DMA_DIR_MEM_TO_PERIPH << DMA_CR_DIR_BIT) |          /* Set direction */
+        DMA_SxCR_TCIE;                                       /* Transfer complete IRQ */
+
+    USART_TX_DMA->PAR = (uint32_t)&USART2->DR;
+    USART_TX_DMA->M0AR = (uint32_t)buf;
+    USART_TX_DMA->NDTR = n_bytes;
+
+    /* Clear stale flags before the stream is enabled */
+    DMA1->HIFCR = DMA_HIFCR_CTCIF6 | DMA_HIFCR_CHTIF6 | DMA_HIFCR_CTEIF6 | DMA_HIFCR_CDMEIF6 | DMA_HIFCR_CFEIF6;
+    /* rc_w0 flag, writing ones leaves other flags untouched unlike read-modify-write */
+    USART2->SR = ~USART_SR_TC;
+
+    USART_TX_DMA->CR |= DMA_SxCR_EN;
+
+    return 0;
+}
+
+int32_t usart_tx_wait(const int32_t ms)
+{
+    if(rtos_sem_take(tx_sem_bin, ms) != true)
     {
         /* Report timeout */
         return -EBUSY;
     }
 
-    for(uint8_t i = 0; i < n_bytes; i++)
+    rtos_sem_give(tx_sem_bin);
+
+    return 0;
+}
+
+int32_t usart_set_baud(const uint32_t baud)
+{
+    if((baud == 0) || (baud > (APB1_CLOCK_FREQ / 16)))
     {
-        rtos_queue_send(tx_queue, &buf[i], 5);
+        /* Invalid arguments */
+        return -EINVAL;
     }
 
-    /* Enable TX Irq */
-    USART2->CR1 |= USART_CR1_TXEIE;
+    /* Don't change speed in the middle of a frame */
+    if(usart_tx_wait(USART_TX_TIMEOUT) != 0)
+    {
+        return -EBUSY;
+    }
+    while((USART2->SR & USART_SR_TC) == 0)
+        ;
+
+    USART2->CR1 &= ~USART_CR1_UE;
+    USART2->BRR = USART_BRR_VAL(APB1_CLOCK_FREQ, baud);
+    USART2->CR1 |= USART_CR1_UE;
 
     return 0;
 }
 
-int32_t usart_read_buf(uint8_t* buf, const int32_t n_bytes)
+void usart_rx_flush(void)
+{
+    rx_overruns_seen = rx_overruns;
+    /* Stamps first, bytes published meanwhile are dropped together with their stamp */
+    rx_stamps_tail = rx_stamps_head;
+    ring_buf_consume(&rx_ring, ring_buf_count(&rx_ring));
+}
+
+uint32_t usart_rx_overruns_get(void)
+{
+    return rx_overruns;
+}
+
+bool usart_idle(void)
+{
+    /* Last byte is still shifted out after DMA finished */
+    if((USART_TX_DMA->CR & DMA_SxCR_EN) || ((USART2->SR & USART_SR_TC) == 0))
+    {
+        return false;
+    }
+
+    return (rtos_tick_count_get() - rx_last_tick) >= (USART_RX_QUIET_MS / portTICK_RATE_MS);
+}
+
+void usart_rx_wakeup_set(bool enable)
 {
+    if(enable)
+    {
+        /* Start bit on idle line is the falling edge */
+        EXTI->PR = (1 << USART_RX_PIN);
+        EXTI->FTSR |= (1 << USART_RX_PIN);
+        EXTI->IMR |= (1 << USART_RX_PIN);
+    }
+    else
+    {
+        /* Pending wakeup is still handled to mark rx activity */
+        EXTI->IMR &= ~(1 << USART_RX_PIN);
+        EXTI->FTSR &= ~(1 << USART_RX_PIN);
+    }
+}
+
+int32_t usart_read_buf(uint8_t* buf, const int32_t n_bytes, const uint32_t ms, uint32_t* time)
+{
+    struct usart_rx_stamp stamp;
+    uint32_t len = n_bytes;
+
     if((buf == NULL) || (n_bytes < 1))
     {
         /* Invalid arguments */
         return -EINVAL;
     }
 
-    if(rtos_sem_take(rx_sem_bin, 10) != true)
+    /* Reader is the only consumer, interrupts wake it up */
+    ring_buf_set_notify(&rx_ring, rtos_task_current(), RX_NOTIFY_THRESHOLD);
+
+    if((ring_buf_count(&rx_ring) == 0) && (rtos_task_notify_take(ms) == 0))
     {
         /* Report timeout */
         return -EBUSY;
     }
 
-    uint8_t bytes_read = 0;
-    for(uint8_t i = 0; i < n_bytes; i++)
+    if(rx_overruns != rx_overruns_seen)
+    {
+        /* Ring holds mix of old and new bytes, drop all of it */
+        usart_rx_flush();
+        return -EOVERFLOW;
+    }
+
+    if(!usart_rx_stamp_get(&stamp))
     {
-        if(rtos_queue_receive(rx_queue, &buf[i], 5) != pdTRUE)
+        stamp.time = 0;
+    }
+    else if((stamp.head - ring_buf_read_pos(&rx_ring)) < len)
+    {
+        /* Bytes of one publication only, so the stamp covers all of them */
+        len = stamp.head - ring_buf_read_pos(&rx_ring);
+    }
+
+    if(time != NULL)
+    {
+        *time = stamp.time;
+    }
+
+    return ring_buf_pop(&rx_ring, buf, len);
+}
+
+static bool usart_rx_stamp_get(struct usart_rx_stamp* stamp)
+{
+    bool found = false;
+
+    rtos_critical_section_enter();
+
+    if((rx_stamps_head - rx_stamps_tail) > RX_STAMPS)
+    {
+        /* Reader fell behind, oldest publications were overwritten */
+        rx_stamps_tail = rx_stamps_head - RX_STAMPS;
+    }
+
+    for(; rx_stamps_tail != rx_stamps_head; rx_stamps_tail++)
+    {
+        *stamp = rx_stamps[rx_stamps_tail & (RX_STAMPS - 1)];
+
+        if((int32_t)(stamp->head - ring_buf_read_pos(&rx_ring)) > 0)
         {
+            found = true;
             break;
         }
-
-        bytes_read++;
     }
 
-    return bytes_read;
+    rtos_critical_section_exit();
+
+    return found;
 }
 
 void gpio_init(void)
@@ -129,48 +336,150 @@ void gpio_init(void)
 
     gpio_af_config(GPIOA, USART_TX_PIN, GPIO_AF_USART2);
     gpio_af_config(GPIOA, USART_RX_PIN, GPIO_AF_USART2);
+
+    /* EXTI line 3 connected to port A for wakeup on rx, enabled only in STOP mode */
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    SYSCFG->EXTICR[0] &= ~SYSCFG_EXTICR1_EXTI3;
+
+    NVIC_SetPriority(EXTI3_IRQn, USART_PRIORITY);
+    NVIC_EnableIRQ(EXTI3_IRQn);
 }
 
 void usart2_init(void)
 {
     RCC->APB1ENR |= RCC_APB1ENR_USART2EN;
 
-    USART2->BRR = APB1_CLOCK_FREQ / USART_BAUD_RATE;           /* Calculate USART BaudRate */
-    USART2->CR1 = USART_CR1_RXNEIE;                            /* Enable RX Irq */
+    USART2->BRR = USART_BRR_VAL(APB1_CLOCK_FREQ, USART_BAUD_RATE); /* Calculate USART BaudRate */
+    USART2->CR3 = USART_CR3_DMAR | USART_CR3_DMAT;             /* Enable RX and TX DMA requests */
+    USART2->CR1 = USART_CR1_IDLEIE;                            /* Enable IDLE line Irq */
     USART2->CR1 |= USART_CR1_RE | USART_CR1_TE | USART_CR1_UE; /* Enable Receiver, Transmiter, and USART */
 
     NVIC_SetPriority(USART2_IRQn, USART_PRIORITY);
     NVIC_EnableIRQ(USART2_IRQn);
 }
 
+static void dma_rx_init(void)
+{
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+
+    USART_RX_DMA->CR = (DMA_CHANNEL_4 << DMA_CR_CHSEL_BIT) | /* Set channel 4 */
+        (DMA_PRIO_MEDIUM << DMA_CR_PL_BIT) |                 /* Priority set to medium */
+        (DMA_SIZE_8BIT << DMA_CR_MSIZE_BIT) |                /* Set memory size */
+        (DMA_SIZE_8BIT << DMA_CR_PSIZE_BIT) |                /* Set peripheral size */
+        DMA_SxCR_MINC |                                      /* Memory increment */
+        DMA_SxCR_CIRC |                                      /* Circular mode */
+        (DMA_DIR_PERIPH_TO_MEM << DMA_CR_DIR_BIT) |          /* Set direction */
+        DMA_SxCR_HTIE |                                      /* Half transfer IRQ */
+        DMA_SxCR_TCIE;                                       /* Transfer complete IRQ */
+
+    USART_RX_DMA->PAR = (uint32_t)&USART2->DR;
+    USART_RX_DMA->M0AR = (uint32_t)rx_dma_buf;
+    USART_RX_DMA->NDTR = RX_DMA_BUF_LEN;
+    ring_buf_init(&rx_ring, rx_dma_buf, RX_DMA_BUF_LEN);
+
+    USART_RX_DMA->CR |= DMA_SxCR_EN;
+
+    NVIC_SetPriority(DMA1_Stream5_IRQn, DMA_USART_RX_PRIORITY);
+    NVIC_EnableIRQ(DMA1_Stream5_IRQn);
+}
+
+static void dma_tx_init(void)
+{
+    RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN;
+
+    NVIC_SetPriority(DMA1_Stream6_IRQn, DMA_USART_TX_PRIORITY);
+    NVIC_EnableIRQ(DMA1_Stream6_IRQn);
+}
+
+static void dma_rx_commit_isr(int32_t* yield)
+{
+    /* NDTR counts down from buffer length and reloads in circular mode */
+    uint32_t dma_pos = RX_DMA_BUF_LEN - USART_RX_DMA->NDTR;
+    /* Ring head modulo its size is the position of the last commit */
+    uint32_t written = (dma_pos - ring_buf_write_pos(&rx_ring)) & (RX_DMA_BUF_LEN - 1);
+
+    if(written > ring_buf_space(&rx_ring))
+    {
+        /* DMA wrapped over unread bytes, only reader may move tail, so it drops the ring */
+        rx_overruns++;
+    }
+
+    /* Head follows DMA position also after overrun, next commit is counted from it */
+    ring_buf_commit_isr(&rx_ring, written, yield);
+
+    if(written != 0)
+    {
+        uint32_t n = rx_stamps_head;
+
+        rx_stamps[n & (RX_STAMPS - 1)].head = ring_buf_write_pos(&rx_ring);
+        rx_stamps[n & (RX_STAMPS - 1)].time = latency_stats_time_get();
+        rx_stamps_head = n + 1;
+    }
+
+    rx_last_tick = rtos_tick_count_get_isr();
+}
+
 void USART2_IRQHandler(void)
 {
+    uint32_t start = cpu_stats_isr_enter(CPU_STATS_ISR_USART);
     int32_t yield = 0;
-    uint8_t tx_data, rx_data;
+    volatile uint32_t dummy;
 
-    if(USART2->SR & USART_SR_TXE)
+    if(USART2->SR & USART_SR_IDLE)
     {
-        if(rtos_queue_receive_isr(tx_queue, &tx_data, &yield) == pdTRUE)
-        {
-            USART2->DR = tx_data;
-        }
-        else
-        {
-            rtos_sem_give_isr(tx_sem_bin, yield);
+        /* Clear IDLE flag by reading SR and DR, data is already moved by DMA */
+        dummy = USART2->DR;
+        (void)dummy;
 
-            USART2->CR1 &= ~(USART_CR1_TXEIE);
-        }
+        /* End of packet, wake up reader regardless of fill level */
+        dma_rx_commit_isr(&yield);
+        ring_buf_notify_isr(&rx_ring, &yield);
+    }
+
+    cpu_stats_isr_exit(CPU_STATS_ISR_USART, start);
+    portYIELD_FROM_ISR(yield);
+}
+
+void DMA1_Stream5_IRQHandler(void)
+{
+    uint32_t start = cpu_stats_isr_enter(CPU_STATS_ISR_USART_RX_DMA);
+    int32_t yield = 0;
+
+    if((DMA1->HISR & (DMA_HISR_HTIF5 | DMA_HISR_TCIF5)) != 0)
+    {
+        /* Half of the buffer filled, publish data before it is overwritten */
+        DMA1->HIFCR = DMA_HIFCR_CHTIF5 | DMA_HIFCR_CTCIF5;
+
+        dma_rx_commit_isr(&yield);
     }
 
-    if(USART2->SR & USART_SR_RXNE)
+    cpu_stats_isr_exit(CPU_STATS_ISR_USART_RX_DMA, start);
+    portYIELD_FROM_ISR(yield);
+}
+
+void DMA1_Stream6_IRQHandler(void)
+{
+    uint32_t start = cpu_stats_isr_enter(CPU_STATS_ISR_USART_TX_DMA);
+    int32_t yield = 0;
+
+    if((DMA1->HISR & DMA_HISR_TCIF6) != 0)
     {
-        rx_data = USART2->DR;
+        /* Clear transfer complete flag and DMA enable flag */
+        DMA1->HIFCR = DMA_HIFCR_CTCIF6;
+        USART_TX_DMA->CR &= ~(DMA_SxCR_EN);
 
-        if(rtos_queue_send_isr(rx_queue, &rx_data, &yield) == pdTRUE)
-        {
-            rtos_sem_give_isr(rx_sem_bin, yield);
-        }
+        /* Whole buffer moved to USART, give it back to the caller */
+        rtos_sem_give_isr(tx_sem_bin, &yield);
     }
 
+    cpu_stats_isr_exit(CPU_STATS_ISR_USART_TX_DMA, start);
     portYIELD_FROM_ISR(yield);
 }
+
+void EXTI3_IRQHandler(void)
+{
+    /* Start bit woke up the core, keep it out of STOP mode while data flows */
+    EXTI->PR = (1 << USART_RX_PIN);
+
+    rx_last_tick = rtos_tick_count_get_isr();
+}
@@ -21,13 +21,18 @@
 /**
  * Initialize USART driver to work.
  *
- * This function initializes Tx to work with DMA and Rx to work with polling.
+ * This function initializes Tx to work with DMA and Rx to work with
+ * circular DMA, woken up by IDLE line and half/full transfer interrupts.
  */
 void usart_init(void);
 
 /**
  * Send buffer through USART.
  *
+ * Buffer is streamed by DMA without copying. It is owned by the driver
+ * after successful call and must not be modified until usart_tx_wait()
+ * returns 0 or the next usart_send_buf() call succeeds.
+ *
  * @param buf           Buffer to send.
  * @param len           Length of buffer.
  *
@@ -35,14 +40,77 @@ void usart_init(void);
  */
 int32_t usart_send_buf(uint8_t* buf, const int32_t len);
 
+/**
+ * Wait for the end of the last tx transfer.
+ *
+ * @param ms            Time to wait in ms.
+ *
+ * @return              0 when buffer is back to the caller, -EBUSY on timeout.
+ */
+int32_t usart_tx_wait(const int32_t ms);
+
+/**
+ * Change USART baud rate.
+ *
+ * Waits for the end of tx transfer before reprogramming the peripheral.
+ *
+ * @param baud          New baud rate.
+ *
+ * @return              Error code.
+ */
+int32_t usart_set_baud(const uint32_t baud);
+
+/**
+ * Drop all received and not read data.
+ */
+void usart_rx_flush(void);
+
 /**
  * Read buffer from USART.
  *
+ * Waits for data only if nothing was received yet, then returns all
+ * received bytes up to len. Reader is woken by IDLE line and rx DMA
+ * interrupts, so stream readers wait with portMAX_DELAY.
+ *
+ * Bytes are published on IDLE line or rx DMA interrupt, so the end of a
+ * packet is stamped one character time after its last byte. Returned
+ * bytes come from a single publication, so time covers all of them.
+ *
  * @param buf          Buffer to read.
  * @param len          Length of buffer.
+ * @param ms           Time to wait for data in ms.
+ * @param time         Value of latency_stats_time_get() at publication, may be NULL.
+ *
+ * @return int32_t     Error code or Bytes Read amount, -EBUSY on timeout,
+ *                     -EOVERFLOW when received bytes were dropped after overrun.
+ */
+int32_t usart_read_buf(uint8_t* buf, const int32_t len, const uint32_t ms, uint32_t* time);
+
+/**
+ * Get number of rx overruns.
+ *
+ * Overrun happens when rx DMA overwrites bytes not read yet, all unread
+ * bytes are dropped then.
+ *
+ * @return              Number of overruns since init.
+ */
+uint32_t usart_rx_overruns_get(void);
+
+/**
+ * Check if USART can be stopped without losing data.
+ *
+ * Link is treated as silent when nothing was received for a while, its
+ * first bytes after wakeup from STOP mode are lost.
+ *
+ * @return              true when tx is finished and rx is silent.
+ */
+bool usart_idle(void);
+
+/**
+ * Enable wakeup from STOP mode on rx start bit.
  *
- * @return int32_t     Error code or Bytes Read amount.
+ * @param enable        true before entering STOP mode, false after wakeup.
  */
-int32_t usart_read_buf(uint8_t* buf, const int32_t len);
+void usart_rx_wakeup_set(bool enable);
 
 #endif /* _USART_H_ */
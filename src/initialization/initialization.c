@@ -1,12 +1,28 @@
+#include "battery.h"
+#include "button.h"
 #include "core_init.h"
 #include "display.h"
 #include "hm_10.h"
+#include "low_power.h"
+#include "startup.h"
+#include "telemetry_task.h"
 
 void system_init(void)
 {
     core_init();
 
-    hm_10_task_init();
+    low_power_init();
+
+    battery_init();
+
+    button_init();
+
+    /* Startup steps of tasks below report readiness here */
+    startup_init();
+
+    hm_10_init();
+
+    telemetry_task_init();
 
     display_tasks_init();
 }
\ No newline at end of file
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+@file bitmap_pages.py
+@author cF-embedded (cf@embedded.pl)
+@brief Conversion of row-major bitmaps into ssd1306 page-major arrays
+
+Every `const uint8_t <name>_bitmap[]` found in input headers is converted
+using `<NAME>_BITMAP_AREA_WIDTH`, `<NAME>_BITMAP_AREA_HEIGHT` and
+`<NAME>_BITMAP_AREA_Y` defines from any input header, so screen positions
+can live in a layout header shared with firmware. Output arrays hold the
+screen buffer pages already flipped and shifted for the area y position, so
+they are drawn with ssd1306_draw_pages() at `<NAME>_BITMAP_PAGES_FIRST`.
+
+@copyright Copyright (c) 2024
+"""
+
+import argparse
+import os
+import re
+
+# SSD1306 Width in pixels
+SSD1306_WIDTH = 128
+# SSD1306 Height in pixels
+SSD1306_HEIGHT = 64
+
+DEFINE_RE = re.compile(r"^\s*#define\s+(\w+)\s+(\d+)\s*$", re.MULTILINE)
+ARRAY_RE = re.compile(r"const\s+uint8_t\s+(\w+)_bitmap\s*\[\s*\]\s*=\s*\{(.*?)\}\s*;", re.DOTALL)
+
+
+def bitmap_pixel(data, stride, x, y):
+    return (data[y * stride + x // 8] >> (7 - (x % 8))) & 1
+
+
+def convert(data, width, height, area_y):
+    """Return first page number and list of pages, each page is list of column bytes."""
+    stride = (width + 7) // 8
+    rows = min(height, SSD1306_HEIGHT - area_y)
+
+    # Screen is flipped, bitmap row i lands on screen row (SSD1306_HEIGHT - 1 - area_y - i)
+    page_first = (SSD1306_HEIGHT - area_y - rows) // 8
+    page_last = (SSD1306_HEIGHT - 1 - area_y) // 8
+
+    pages = []
+    for page in range(page_first, page_last + 1):
+        columns = []
+        for x in range(width):
+            byte = 0
+            for bit in range(8):
+                row = SSD1306_HEIGHT - 1 - area_y - (page * 8 + bit)
+                if 0 <= row < rows and bitmap_pixel(data, stride, x, row):
+                    byte |= 1 << bit
+            columns.append(byte)
+        pages.append(columns)
+
+    return page_first, pages
+
+
+def read_header(path):
+    with open(path) as header:
+        return header.read()
+
+
+def parse_header(text, defines):
+    for name, body in ARRAY_RE.findall(text):
+        prefix = name.upper() + "_BITMAP_AREA_"
+        data = [int(value, 0) for value in body.replace("\n", " ").split(",") if value.strip()]
+        yield name, data, defines[prefix + "WIDTH"], defines[prefix + "HEIGHT"], defines[prefix + "Y"]
+
+
+def write_output(path, bitmaps):
+    guard = "_" + os.path.basename(path).upper().replace(".", "_")
+
+    lines = [
+        "/**",
+        " * @file " + os.path.basename(path),
+        " * @brief Bitmaps in ssd1306 page-major format, generated by bitmap_pages.py",
+        " *",
+        " * Do not edit, change source bitmap headers instead.",
+        " */",
+        "",
+        "#ifndef " + guard,
+        "#define " + guard,
+        "",
+        "#include \"platform_specific.h\"",
+        "",
+    ]
+
+    for name, width, page_first, pages in bitmaps:
+        macro = name.upper() + "_BITMAP_PAGES_"
+        lines += [
+            "/* First screen page of " + name + " bitmap */",
+            "#define {}FIRST {}".format(macro, page_first),
+            "/* Number of screen pages of " + name + " bitmap */",
+            "#define {}COUNT {}".format(macro, len(pages)),
+            "/* Width of single page of " + name + " bitmap */",
+            "#define {}WIDTH {}".format(macro, width),
+            "",
+            "static const uint8_t {}_bitmap_pages[] = {{".format(name),
+        ]
+        for columns in pages:
+            for start in range(0, len(columns), 16):
+                lines.append("    " + " ".join("0x{:02x},".format(c) for c in columns[start:start + 16]))
+        lines += ["};", ""]
+
+    lines += ["#endif /* " + guard + " */", ""]
+
+    with open(path, "w") as output:
+        output.write("\n".join(lines))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert row-major bitmaps into ssd1306 page-major arrays")
+    parser.add_argument("output", help="generated header path")
+    parser.add_argument("headers", nargs="+", help="headers with row-major bitmaps and their layout defines")
+    args = parser.parse_args()
+
+    texts = [read_header(header) for header in args.headers]
+    defines = {}
+    for text in texts:
+        defines.update({name: int(value) for name, value in DEFINE_RE.findall(text)})
+
+    bitmaps = []
+    for text in texts:
+        for name, data, width, height, area_y in parse_header(text, defines):
+            page_first, pages = convert(data, width, height, area_y)
+            bitmaps.append((name, width, page_first, pages))
+
+    write_output(args.output, bitmaps)
+
+
+if __name__ == "__main__":
+    main()
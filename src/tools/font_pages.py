@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""
+@file font_pages.py
+@author cF-embedded (cf@embedded.pl)
+@brief Conversion of column fonts into ssd1306 page-major glyphs
+
+Source font is the 5x7 column font from font_ascii_5x7.h, where each byte is
+one glyph column and bit 0 is the top row. Glyph bytes are generated already
+flipped for the screen buffer, page after page starting from the top one, so
+ssd1306_draw_text() copies them without touching single pixels. Larger fonts
+are made by scaling the source glyphs.
+
+@copyright Copyright (c) 2024
+"""
+
+import argparse
+import os
+import re
+
+# Source font glyph width in columns
+SOURCE_WIDTH = 5
+
+# name, first char, last char, scale, spacing in columns
+FONTS = [
+    ("ssd1306_font_5x7", 0x00, 0xEC, 1, 2),
+    ("ssd1306_font_digits_10x14", ord(" "), ord("9"), 2, 2),
+]
+
+
+def parse_font(path):
+    with open(path) as header:
+        text = header.read()
+
+    body = text[text.index("{") + 1:text.index("}")]
+    values = [int(value, 16) for value in re.findall(r"0x[0-9A-Fa-f]+", body)]
+
+    return [values[i:i + SOURCE_WIDTH] for i in range(0, len(values), SOURCE_WIDTH)]
+
+
+def scale_glyph(columns, scale):
+    """Return glyph as list of columns, each column is list of pixels from the top."""
+    glyph = []
+    for column in columns:
+        pixels = []
+        for row in range(8):
+            pixels += [(column >> row) & 1] * scale
+        glyph += [pixels] * scale
+    return glyph
+
+
+def glyph_pages(glyph, n_pages):
+    """Return page bytes of glyph, top page first, bit 7 is the top row of the page."""
+    data = []
+    for page in range(n_pages):
+        for pixels in glyph:
+            byte = 0
+            for bit in range(8):
+                row = page * 8 + 7 - bit
+                if row < len(pixels) and pixels[row]:
+                    byte |= 1 << bit
+            data.append(byte)
+    return data
+
+
+def write_output(path, source, fonts):
+    lines = [
+        "/**",
+        " * @file " + os.path.basename(path),
+        " * @brief Fonts in ssd1306 page-major format, generated by font_pages.py",
+        " *",
+        " * Do not edit, change " + os.path.basename(source) + " or font_pages.py instead.",
+        " */",
+        "",
+        "#include \"ssd1306_fonts.h\"",
+        "",
+    ]
+
+    for name, glyphs, first, last, width, n_pages, spacing in fonts:
+        lines.append("static const uint8_t {}_glyphs[] = {{".format(name))
+        for char, data in zip(range(first, last + 1), glyphs):
+            lines.append("    /* 0x{:02x} */ ".format(char) + " ".join("0x{:02x},".format(b) for b in data))
+        lines += [
+            "};",
+            "",
+            "const struct ssd1306_font {} = {{".format(name),
+            "    .glyphs = {}_glyphs,".format(name),
+            "    .first_char = 0x{:02x},".format(first),
+            "    .last_char = 0x{:02x},".format(last),
+            "    .width = {},".format(width),
+            "    .pages = {},".format(n_pages),
+            "    .spacing = {},".format(spacing),
+            "};",
+            "",
+        ]
+
+    with open(path, "w") as output:
+        output.write("\n".join(lines))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert column fonts into ssd1306 page-major glyphs")
+    parser.add_argument("output", help="generated source path")
+    parser.add_argument("font", help="header with 5x7 column font")
+    args = parser.parse_args()
+
+    source = parse_font(args.font)
+
+    fonts = []
+    for name, first, last, scale, spacing in FONTS:
+        n_pages = (8 * scale + 7) // 8
+        glyphs = [glyph_pages(scale_glyph(source[char], scale), n_pages) for char in range(first, last + 1)]
+        fonts.append((name, glyphs, first, last, SOURCE_WIDTH * scale, n_pages, spacing))
+
+    write_output(args.output, args.font, fonts)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""
+@file trace_decode.py
+@author cF-embedded (cf@embedded.pl)
+@brief Decoder of binary trace ring dumped from RAM
+
+Input is the memory of `trace_ring` from trace.h, e.g. dumped by gdb with
+`dump binary value trace.bin trace_ring`. Output is a timeline of events and
+histograms of interrupt handler durations and task wakeup latencies, measured
+from task notification to the notified task switching in.
+
+@copyright Copyright (c) 2024
+
+"""
+
+import argparse
+import struct
+
+TRACE_MAGIC = 0x31435254
+
+# magic, cpu_freq, len, max_tasks, name_len, event_size, head
+HEADER = struct.Struct("<IIHHHHI")
+# time, type, id, arg
+EVENT = struct.Struct("<IBBH")
+
+# enum cpu_stats_isr
+ISR_NAMES = [
+    "USART2",
+    "USART_RX_DMA",
+    "USART_TX_DMA",
+    "I2C1_EV",
+    "I2C1_ER",
+    "I2C_TX_DMA",
+    "I2C_RX_DMA",
+    "BATTERY_DMA",
+    "BUTTON_EXTI",
+    "BUTTON_TIM",
+]
+
+# ucQueueType of FreeRTOS queues
+QUEUE_TYPES = ["queue", "mutex", "counting_sem", "binary_sem", "recursive_mutex"]
+
+# enum trace_event_type
+EVENT_NAMES = {
+    1: "isr_enter",
+    2: "isr_exit",
+    3: "task_switch",
+    4: "task_create",
+    5: "task_delete",
+    6: "queue_send",
+    7: "queue_send_isr",
+    8: "queue_send_fail",
+    9: "queue_receive",
+    10: "queue_receive_isr",
+    11: "queue_receive_fail",
+    12: "queue_block",
+    13: "notify",
+    14: "notify_isr",
+    15: "notify_block",
+    16: "idle_sleep",
+    17: "idle_wakeup",
+    18: "user",
+}
+
+ISR_ENTER, ISR_EXIT, TASK_SWITCH, TASK_CREATE, TASK_DELETE = 1, 2, 3, 4, 5
+QUEUE_FIRST, QUEUE_LAST = 6, 12
+NOTIFY, NOTIFY_ISR, NOTIFY_BLOCK = 13, 14, 15
+USER = 18
+
+
+def parse(data):
+    magic, cpu_freq, length, max_tasks, name_len, event_size, head = HEADER.unpack_from(data)
+    if magic != TRACE_MAGIC:
+        raise ValueError("no trace ring magic, wrong dump address?")
+
+    offset = HEADER.size
+    names = {}
+    for number in range(1, max_tasks + 1):
+        raw = data[offset:offset + name_len].split(b"\0")[0]
+        if raw:
+            names[number] = raw.decode("ascii", "replace")
+        offset += name_len
+
+    # Events are aligned as uint32_t
+    offset = (offset + 3) & ~3
+    slots = [EVENT.unpack_from(data, offset + i * event_size) for i in range(length)]
+
+    if head <= length:
+        events = slots[:head]
+    else:
+        start = head % length
+        events = slots[start:] + slots[:start]
+
+    return cpu_freq, names, events, max(0, head - length)
+
+
+def unwrap(events):
+    """Return events with 64-bit times, counter wraps every 51 s at 84 MHz."""
+    result = []
+    now = None
+    for time, kind, source, arg in events:
+        if now is None:
+            now = time
+        else:
+            # Events written by preempting interrupt may be a few cycles out of order
+            delta = (time - now) & 0xFFFFFFFF
+            if delta >= 0x80000000:
+                delta -= 0x100000000
+            now += delta
+        result.append((now, kind, source, arg))
+    return result
+
+
+def task_name(names, number):
+    return names.get(number, "task{}".format(number))
+
+
+def isr_name(source):
+    return ISR_NAMES[source] if source < len(ISR_NAMES) else "isr{}".format(source)
+
+
+def describe(names, kind, source, arg):
+    name = EVENT_NAMES.get(kind, "event{}".format(kind))
+    if kind in (ISR_ENTER, ISR_EXIT):
+        return "{} {}".format(name, isr_name(source))
+    if kind in (TASK_SWITCH, TASK_CREATE):
+        return "{} {} prio {}".format(name, task_name(names, source), arg)
+    if kind in (TASK_DELETE, NOTIFY, NOTIFY_ISR, NOTIFY_BLOCK):
+        return "{} {}".format(name, task_name(names, source))
+    if QUEUE_FIRST <= kind <= QUEUE_LAST:
+        queue_type = QUEUE_TYPES[source] if source < len(QUEUE_TYPES) else str(source)
+        return "{} {} 0x2000{:04x}".format(name, queue_type, arg)
+    if kind == USER:
+        return "{} {} value {}".format(name, source, arg)
+    return name
+
+
+def print_timeline(freq, names, events):
+    start = events[0][0]
+    prev = start
+    for time, kind, source, arg in events:
+        print("{:12.2f} {:+10.2f}  {}".format((time - start) * 1e6 / freq, (time - prev) * 1e6 / freq, describe(names, kind, source, arg)))
+        prev = time
+
+
+def collect_latencies(names, events):
+    isr_durations = {}
+    wakeups = {}
+    isr_start = {}
+    woken = {}
+
+    for time, kind, source, arg in events:
+        if kind == ISR_ENTER:
+            isr_start[source] = time
+        elif kind == ISR_EXIT and source in isr_start:
+            isr_durations.setdefault(isr_name(source), []).append(time - isr_start.pop(source))
+        elif kind in (NOTIFY, NOTIFY_ISR):
+            # Only the first notification before task runs starts its latency
+            woken.setdefault(source, time)
+        elif kind == TASK_SWITCH and source in woken:
+            wakeups.setdefault(task_name(names, source), []).append(time - woken.pop(source))
+
+    return isr_durations, wakeups
+
+
+def print_histogram(title, samples, freq):
+    us = sorted(sample * 1e6 / freq for sample in samples)
+    count = len(us)
+    print("{}: n {} min {:.2f} p50 {:.2f} p99 {:.2f} max {:.2f} us".format(
+        title, count, us[0], us[count // 2], us[min(count - 1, (count * 99) // 100)], us[-1]))
+
+    # Power of two buckets in us
+    buckets = {}
+    for value in us:
+        bucket = 1
+        while bucket < value:
+            bucket *= 2
+        buckets[bucket] = buckets.get(bucket, 0) + 1
+
+    width = max(buckets.values())
+    for bucket in sorted(buckets):
+        print("  <= {:8d} us {:6d} {}".format(bucket, buckets[bucket], "#" * max(1, (40 * buckets[bucket]) // width)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode binary trace ring dumped from RAM")
+    parser.add_argument("dump", help="binary dump of trace_ring")
+    parser.add_argument("--no-timeline", action="store_true", help="print only histograms")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as dump:
+        freq, names, events, lost = parse(dump.read())
+
+    if not events:
+        print("no events")
+        return
+
+    events = unwrap(events)
+
+    print("{} events, {} older overwritten, {:.3f} ms".format(len(events), lost, (events[-1][0] - events[0][0]) * 1e3 / freq))
+
+    if not args.no_timeline:
+        print_timeline(freq, names, events)
+
+    isr_durations, wakeups = collect_latencies(names, events)
+
+    for name in sorted(isr_durations):
+        print_histogram("isr " + name, isr_durations[name], freq)
+    for name in sorted(wakeups):
+        print_histogram("wakeup " + name, wakeups[name], freq)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+/**
+ * @file cpu_stats.c
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief CPU usage of tasks and interrupts measured with DWT cycle counter
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "cpu_stats.h"
+#include <string.h>
+
+/* Cycle counter ticks per ms */
+#define CPU_STATS_CYCLES_MS (MCU_CLOCK_FREQ / 1000)
+
+volatile uint32_t cpu_stats_isr_cycles[CPU_STATS_ISR_COUNT];
+
+/* Task states filled by RTOS, too big for stack of reporting task */
+static TaskStatus_t task_status[CPU_STATS_MAX_TASKS];
+
+/**
+ * Run time of task at previous report.
+ */
+struct cpu_stats_prev
+{
+    UBaseType_t number; /**< Unique task number */
+    uint32_t time;      /**< Run time counter */
+};
+
+/* Values at previous report, deltas are reported so counters may wrap */
+static struct cpu_stats_prev prev_tasks[CPU_STATS_MAX_TASKS];
+static uint32_t prev_n_tasks;
+static uint32_t prev_total;
+static uint32_t prev_isr_cycles[CPU_STATS_ISR_COUNT];
+
+/**
+ * @brief Get run time counter of task at previous report
+ *
+ * @param number - unique task number
+ * @return uint32_t - run time counter, 0 for task created since then
+ */
+static uint32_t cpu_stats_prev_time(UBaseType_t number);
+
+void cpu_stats_timer_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t cpu_stats_time_get(void)
+{
+    return DWT->CYCCNT >> CPU_STATS_TIME_SHIFT;
+}
+
+void cpu_stats_sleep_add(uint32_t cycles)
+{
+    DWT->CYCCNT += cycles;
+}
+
+static uint32_t cpu_stats_prev_time(UBaseType_t number)
+{
+    for(uint32_t i = 0; i < prev_n_tasks; i++)
+    {
+        if(prev_tasks[i].number == number)
+        {
+            return prev_tasks[i].time;
+        }
+    }
+
+    return 0;
+}
+
+int32_t cpu_stats_report_get(struct cpu_stats_report* report)
+{
+    uint32_t total;
+    UBaseType_t n_tasks = uxTaskGetSystemState(task_status, CPU_STATS_MAX_TASKS, &total);
+
+    if(n_tasks == 0)
+    {
+        return -ENOSPC;
+    }
+
+    uint32_t window = total - prev_total;
+
+    if(window == 0)
+    {
+        window = 1;
+    }
+
+    prev_total = total;
+    report->window_ms = ((uint64_t)window << CPU_STATS_TIME_SHIFT) / CPU_STATS_CYCLES_MS;
+    report->n_tasks = n_tasks;
+
+    for(uint32_t i = 0; i < n_tasks; i++)
+    {
+        struct cpu_stats_task* task = &report->tasks[i];
+        TaskStatus_t* status = &task_status[i];
+        uint32_t time = status->ulRunTimeCounter - cpu_stats_prev_time(status->xTaskNumber);
+
+        strncpy(task->name, status->pcTaskName, sizeof(task->name));
+        task->name[sizeof(task->name) - 1] = '\0';
+        task->number = status->xTaskNumber;
+        task->priority = status->uxCurrentPriority;
+        task->permille = ((uint64_t)time * 1000) / window;
+        task->stack_free = status->usStackHighWaterMark;
+    }
+
+    /* Deleted tasks are dropped */
+    for(uint32_t i = 0; i < n_tasks; i++)
+    {
+        prev_tasks[i].number = task_status[i].xTaskNumber;
+        prev_tasks[i].time = task_status[i].ulRunTimeCounter;
+    }
+
+    prev_n_tasks = n_tasks;
+
+    for(uint32_t i = 0; i < CPU_STATS_ISR_COUNT; i++)
+    {
+        uint32_t cycles = cpu_stats_isr_cycles[i];
+
+        report->isr_permille[i] = ((uint64_t)(cycles - prev_isr_cycles[i]) * 1000) / ((uint64_t)window << CPU_STATS_TIME_SHIFT);
+        prev_isr_cycles[i] = cycles;
+    }
+
+    return 0;
+}
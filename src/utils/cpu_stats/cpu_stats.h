@@ -0,0 +1,152 @@
+/**
+ * @file cpu_stats.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief CPU usage of tasks and interrupts measured with DWT cycle counter
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _CPU_STATS_H_
+#define _CPU_STATS_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+#include "platform_specific.h"
+#include "trace.h"
+
+/**
+ * @defgroup utils_cpu_stats
+ *
+ * RTOS run time stats are clocked by DWT CYCCNT divided by
+ * 2^CPU_STATS_TIME_SHIFT, so task counters wrap after about 54 minutes.
+ * Interrupt handlers add their own cycles with cpu_stats_isr_enter() and
+ * cpu_stats_isr_exit(), which also record trace events. Interrupt time is
+ * also counted in the interrupted task and time of nested interrupt in the
+ * preempted one.
+ *
+ * @{
+ */
+
+/* Cycle counter divider of RTOS run time stats as power of two */
+#define CPU_STATS_TIME_SHIFT 6
+
+/* Max number of tasks in report */
+#define CPU_STATS_MAX_TASKS 8
+
+/**
+ * Measured interrupt handlers, order is known to tools/trace_decode.py.
+ */
+enum cpu_stats_isr
+{
+    CPU_STATS_ISR_USART,        /**< USART2_IRQHandler */
+    CPU_STATS_ISR_USART_RX_DMA, /**< DMA1_Stream5_IRQHandler */
+    CPU_STATS_ISR_USART_TX_DMA, /**< DMA1_Stream6_IRQHandler */
+    CPU_STATS_ISR_I2C_EV,       /**< I2C1_EV_IRQHandler */
+    CPU_STATS_ISR_I2C_ER,       /**< I2C1_ER_IRQHandler */
+    CPU_STATS_ISR_I2C_TX_DMA,   /**< DMA1_Stream7_IRQHandler */
+    CPU_STATS_ISR_I2C_RX_DMA,   /**< DMA1_Stream0_IRQHandler */
+    CPU_STATS_ISR_BATTERY_DMA,  /**< DMA2_Stream0_IRQHandler */
+    CPU_STATS_ISR_BUTTON_EXTI,  /**< EXTI0_IRQHandler */
+    CPU_STATS_ISR_BUTTON_TIM,   /**< TIM1_TRG_COM_TIM11_IRQHandler */
+    CPU_STATS_ISR_COUNT,
+};
+
+/**
+ * CPU usage of single task.
+ */
+struct cpu_stats_task
+{
+    char name[configMAX_TASK_NAME_LEN]; /**< Task name */
+    uint8_t number;                     /**< Unique task number, in order of creation */
+    uint8_t priority;                   /**< Current priority */
+    uint16_t permille;                  /**< CPU time in 0.1 % */
+    uint16_t stack_free;                /**< Stack never used since task creation in words */
+};
+
+/**
+ * CPU usage since previous report.
+ */
+struct cpu_stats_report
+{
+    uint32_t window_ms;                               /**< Time since previous report */
+    uint8_t n_tasks;                                  /**< Number of tasks, idle task included */
+    struct cpu_stats_task tasks[CPU_STATS_MAX_TASKS]; /**< Usage of tasks */
+    uint16_t isr_permille[CPU_STATS_ISR_COUNT];       /**< CPU time of interrupts in 0.1 % */
+};
+
+/* Cycles spent in interrupt handlers, written only by cpu_stats_isr_exit() */
+extern volatile uint32_t cpu_stats_isr_cycles[CPU_STATS_ISR_COUNT];
+
+/**
+ * @brief Start DWT cycle counter, called by RTOS on scheduler start
+ */
+void cpu_stats_timer_init(void);
+
+/**
+ * @brief Get time of RTOS run time stats
+ *
+ * @return uint32_t - cycle counter divided by 2^CPU_STATS_TIME_SHIFT
+ */
+uint32_t cpu_stats_time_get(void);
+
+/**
+ * @brief Account time when core clock was stopped
+ *
+ * Cycle counter doesn't run in sleep and STOP mode, so idle task is given
+ * time measured by wakeup timer.
+ *
+ * @param cycles - core clock cycles spent in low power mode
+ */
+void cpu_stats_sleep_add(uint32_t cycles);
+
+/**
+ * @brief Get CPU usage since previous call
+ *
+ * First call reports time since scheduler start. Called by single task.
+ *
+ * @param report - usage of tasks and interrupts
+ * @return int32_t - 0 on success, -ENOSPC if there are more than CPU_STATS_MAX_TASKS tasks
+ */
+int32_t cpu_stats_report_get(struct cpu_stats_report* report);
+
+/**
+ * @brief Mark the beginning of measured interrupt handler
+ *
+ * @param isr - measured handler
+ * @return uint32_t - cycle counter passed to cpu_stats_isr_exit()
+ */
+static inline uint32_t cpu_stats_isr_enter(enum cpu_stats_isr isr)
+{
+    trace_event(TRACE_EVENT_ISR_ENTER, isr, 0);
+
+    return DWT->CYCCNT;
+}
+
+/**
+ * @brief Add cycles of measured interrupt handler
+ *
+ * Single handler is never nested with itself, so no locking is needed.
+ *
+ * @param isr - measured handler
+ * @param start - value returned by cpu_stats_isr_enter()
+ */
+static inline void cpu_stats_isr_exit(enum cpu_stats_isr isr, uint32_t start)
+{
+    cpu_stats_isr_cycles[isr] += DWT->CYCCNT - start;
+
+    trace_event(TRACE_EVENT_ISR_EXIT, isr, 0);
+}
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _CPU_STATS_H_ */
@@ -0,0 +1,102 @@
+/**
+ * @file latency_stats.c
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Histogram of telemetry to pixel latency
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "latency_stats.h"
+#include <string.h>
+
+/* Cycle counter ticks per us */
+#define LATENCY_STATS_CYCLES_US (MCU_CLOCK_FREQ / 1000000)
+
+/**
+ * Latencies measured since previous report.
+ */
+struct latency_stats_hist
+{
+    uint32_t count;                          /**< Number of samples */
+    uint32_t min_us;                         /**< Shortest sample */
+    uint32_t max_us;                         /**< Longest sample */
+    uint16_t buckets[LATENCY_STATS_BUCKETS]; /**< Samples in LATENCY_STATS_BUCKET_US wide buckets */
+};
+
+/* Written by flush task and reset by reporting task in critical sections */
+static struct latency_stats_hist hist;
+
+/**
+ * @brief Get latency below which given part of samples is
+ *
+ * @param rank - number of samples up to the percentile, from 1
+ * @return uint32_t - upper edge of bucket holding the sample in us, limited by max
+ */
+static uint32_t latency_stats_percentile(uint32_t rank);
+
+void latency_stats_add(uint32_t start)
+{
+    uint32_t us = (latency_stats_time_get() - start) / LATENCY_STATS_CYCLES_US;
+    uint32_t bucket = us / LATENCY_STATS_BUCKET_US;
+
+    if(bucket >= LATENCY_STATS_BUCKETS)
+    {
+        bucket = LATENCY_STATS_BUCKETS - 1;
+    }
+
+    rtos_critical_section_enter();
+
+    if((hist.count == 0) || (us < hist.min_us))
+    {
+        hist.min_us = us;
+    }
+
+    if(us > hist.max_us)
+    {
+        hist.max_us = us;
+    }
+
+    /* Saturated bucket still counts in percentiles as its maximum */
+    if(hist.buckets[bucket] < UINT16_MAX)
+    {
+        hist.buckets[bucket]++;
+        hist.count++;
+    }
+
+    rtos_critical_section_exit();
+}
+
+static uint32_t latency_stats_percentile(uint32_t rank)
+{
+    uint32_t seen = 0;
+
+    for(uint32_t i = 0; i < LATENCY_STATS_BUCKETS - 1; i++)
+    {
+        seen += hist.buckets[i];
+
+        if(seen >= rank)
+        {
+            uint32_t edge = (i + 1) * LATENCY_STATS_BUCKET_US;
+
+            return (edge < hist.max_us) ? edge : hist.max_us;
+        }
+    }
+
+    return hist.max_us;
+}
+
+void latency_stats_report_get(struct latency_stats_report* report)
+{
+    rtos_critical_section_enter();
+
+    report->count = hist.count;
+    report->min_us = hist.min_us;
+    report->max_us = hist.max_us;
+    report->p50_us = (hist.count > 0) ? latency_stats_percentile((hist.count + 1) / 2) : 0;
+    report->p99_us = (hist.count > 0) ? latency_stats_percentile((hist.count * 99 + 99) / 100) : 0;
+
+    memset(&hist, 0, sizeof(hist));
+
+    rtos_critical_section_exit();
+}
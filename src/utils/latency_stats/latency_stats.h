@@ -0,0 +1,84 @@
+/**
+ * @file latency_stats.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Histogram of telemetry to pixel latency
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _LATENCY_STATS_H_
+#define _LATENCY_STATS_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+#include "platform_specific.h"
+
+/**
+ * @defgroup utils_latency_stats
+ *
+ * Latency is measured from telemetry bytes published by USART rx interrupt
+ * to the end of the flush of the first frame showing them. Times are taken
+ * from DWT cycle counter, which keeps real time over low power idle.
+ *
+ * @{
+ */
+
+/* Width of histogram bucket in us */
+#define LATENCY_STATS_BUCKET_US 1000
+
+/* Number of buckets, the last one counts all longer latencies */
+#define LATENCY_STATS_BUCKETS 128
+
+/**
+ * Latency since previous report.
+ */
+struct latency_stats_report
+{
+    uint32_t count;  /**< Number of measured frames */
+    uint32_t min_us; /**< Shortest latency */
+    uint32_t p50_us; /**< Median, upper edge of its bucket */
+    uint32_t p99_us; /**< 99th percentile, upper edge of its bucket */
+    uint32_t max_us; /**< Longest latency */
+};
+
+/**
+ * @brief Get timestamp of event starting measured latency
+ *
+ * May be called from interrupt.
+ *
+ * @return uint32_t - DWT cycle counter
+ */
+static inline uint32_t latency_stats_time_get(void)
+{
+    return DWT->CYCCNT;
+}
+
+/**
+ * @brief Add latency ending now to histogram
+ *
+ * @param start - value of latency_stats_time_get() at the beginning
+ */
+void latency_stats_add(uint32_t start);
+
+/**
+ * @brief Get latency since previous call and reset histogram
+ *
+ * All values are 0 when nothing was measured.
+ *
+ * @param report - latency summary
+ */
+void latency_stats_report_get(struct latency_stats_report* report);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _LATENCY_STATS_H_ */
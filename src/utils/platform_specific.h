@@ -23,6 +23,7 @@
 #include "queue.h"
 #include "timers.h"
 #include "semphr.h"
+#include "event_groups.h"
 
 /**
  * @defgroup utils_platform
@@ -48,6 +49,7 @@
 /** APB1 bus frequency */
 #define APB1_CLOCK_FREQ       (MCU_CLOCK_FREQ / 4)
 
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
 /**
  * Create RTOS task.
  *
@@ -60,6 +62,22 @@
  */
 #define rtos_task_create(ptr, name, stack, prio, handle)                               \
    xTaskCreate(ptr, (const char *)name, stack, NULL, prio, handle)
+#endif
+
+/**
+ * Create RTOS task in statically allocated memory.
+ *
+ * @param ptr           Pointer to task function.
+ * @param name          Name string.
+ * @param stack         Task stack size in words.
+ * @param prio          Task priority.
+ * @param stack_buf     Task stack, array of stack words.
+ * @param task_buf      Task control block.
+ *
+ * @return              Task handle.
+ */
+#define rtos_task_create_static(ptr, name, stack, prio, stack_buf, task_buf)   \
+   xTaskCreateStatic(ptr, (const char *)name, stack, NULL, prio, stack_buf, task_buf)
 
 /**
  * Set task priority.
@@ -96,6 +114,86 @@
 #define rtos_tick_count_get()                                                  \
    xTaskGetTickCount()
 
+/**
+ * Get current system tick count from the interrupt.
+ *
+ * @return              Tick count.
+ */
+#define rtos_tick_count_get_isr()                                              \
+   xTaskGetTickCountFromISR()
+
+/**
+ * Get handle of the calling task.
+ *
+ * @return              Task handle.
+ */
+#define rtos_task_current()                                                    \
+   xTaskGetCurrentTaskHandle()
+
+/**
+ * Wait for task notification and clear it.
+ *
+ * @param ms            Time to wait for notification.
+ *
+ * @return              Notification value before it was cleared, 0 on timeout.
+ */
+#define rtos_task_notify_take(ms)                                              \
+   ulTaskNotifyTake(pdTRUE, ms/portTICK_RATE_MS)
+
+/**
+ * Notify task from the interrupt.
+ *
+ * @param task          Task handle.
+ * @param yield         Flag indicating if context switch is needed.
+ */
+#define rtos_task_notify_give_isr(task, yield)                                 \
+   vTaskNotifyGiveFromISR(task, yield)
+
+/**
+ * Set notification bits of the task.
+ *
+ * @param task          Task handle.
+ * @param bits          Bits to set in task notification value.
+ */
+#define rtos_task_notify_bits(task, bits)                                      \
+   xTaskNotify(task, bits, eSetBits)
+
+/**
+ * Set notification bits of the task from the interrupt.
+ *
+ * @param task          Task handle.
+ * @param bits          Bits to set in task notification value.
+ * @param yield         Flag indicating if context switch is needed.
+ */
+#define rtos_task_notify_bits_isr(task, bits, yield)                           \
+   xTaskNotifyFromISR(task, bits, eSetBits, yield)
+
+/**
+ * Wait for task notification bits and clear all of them.
+ *
+ * @param bits_ptr      Notification bits set before they were cleared.
+ * @param ms            Time to wait for notification.
+ *
+ * @return              true when notified, false on timeout.
+ */
+#define rtos_task_notify_bits_wait(bits_ptr, ms)                               \
+   xTaskNotifyWait(0, UINT32_MAX, bits_ptr, ms/portTICK_RATE_MS)
+
+/**
+ * Wait for task notification and clear only selected bits.
+ *
+ * Other bits stay in notification value.
+ *
+ * @param bits_ptr      Notification bits set before selected ones were cleared.
+ * @param clear         Bits to clear.
+ * @param ms            Time to wait for notification.
+ *
+ * @return              true when notified, false on timeout.
+ */
+#define rtos_task_notify_bits_wait_clear(bits_ptr, clear, ms)                  \
+   xTaskNotifyWait(0, clear, bits_ptr, ms/portTICK_RATE_MS)
+
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
 /**
  * Create RTOS queue.
  *
@@ -106,6 +204,20 @@
  */
 #define rtos_queue_create(len, item_size)                                      \
    xQueueCreate(len, item_size)
+#endif
+
+/**
+ * Create RTOS queue in statically allocated memory.
+ *
+ * @param len           Length of the queue.
+ * @param item_size     Size of the single item on the queue.
+ * @param storage       Items storage, at least len * item_size bytes.
+ * @param queue_buf     Queue control block.
+ *
+ * @return              Queue handle.
+ */
+#define rtos_queue_create_static(len, item_size, storage, queue_buf)           \
+   xQueueCreateStatic(len, item_size, (uint8_t *)storage, queue_buf)
 
 /**
  * Send data to the queue.
@@ -155,6 +267,7 @@
 #define rtos_queue_send_isr(queue_ptr, data_ptr, yield)                            \
    xQueueSendFromISR(queue_ptr, (void *)data_ptr, yield)
 
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
 /**
  * Create RTOS semaphore.
  *
@@ -162,6 +275,17 @@
  */
 #define rtos_sem_bin_create()                                           \
    xSemaphoreCreateBinary()
+#endif
+
+/**
+ * Create RTOS semaphore in statically allocated memory.
+ *
+ * @param sem_buf       Semaphore control block.
+ *
+ * @return              Semaphore handle.
+ */
+#define rtos_sem_bin_create_static(sem_buf)                                    \
+   xSemaphoreCreateBinaryStatic(sem_buf)
 
 /**
  * Acquire semaphore.
@@ -204,6 +328,7 @@
 
 
 
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
 /**
  * Create RTOS mutex.
  *
@@ -211,6 +336,17 @@
  */
 #define rtos_mutex_create()                                                    \
     xSemaphoreCreateMutex()
+#endif
+
+/**
+ * Create RTOS mutex in statically allocated memory.
+ *
+ * @param mutex_buf     Mutex control block.
+ *
+ * @return              Mutex handle.
+ */
+#define rtos_mutex_create_static(mutex_buf)                                    \
+    xSemaphoreCreateMutexStatic(mutex_buf)
 
 /**
  * Acquire mutex.
@@ -234,6 +370,39 @@
    xSemaphoreGive(mutex_ptr)
 /* Mutexes should not be given/taken from ISR */
 
+/**
+ * Create RTOS event group in statically allocated memory.
+ *
+ * @param group_buf     Event group control block.
+ *
+ * @return              Event group handle.
+ */
+#define rtos_event_group_create_static(group_buf)                              \
+   xEventGroupCreateStatic(group_buf)
+
+/**
+ * Set bits of event group.
+ *
+ * @param group_ptr     Event group handle.
+ * @param bits          Bits to set.
+ *
+ * @return              Bits of event group after the call.
+ */
+#define rtos_event_group_set(group_ptr, bits)                                  \
+   xEventGroupSetBits(group_ptr, bits)
+
+/**
+ * Wait until all bits of event group are set, bits are not cleared.
+ *
+ * @param group_ptr     Event group handle.
+ * @param bits          Bits to wait for.
+ * @param ms            Time to wait for the bits.
+ *
+ * @return              Bits of event group at return.
+ */
+#define rtos_event_group_wait(group_ptr, bits, ms)                             \
+   xEventGroupWaitBits(group_ptr, bits, pdFALSE, pdTRUE, ms/portTICK_RATE_MS)
+
 /**
  * Enter critical section.
  */
@@ -255,9 +424,30 @@ typedef void * sem_t;
 /** Type of RTOS mutex. */
 typedef void * mutex_t;
 
+/** Type of RTOS event group. */
+typedef void * event_group_t;
+
 /** Type of RTOS tick. */
 typedef TickType_t tick_t;
 
+/** Memory of RTOS task control block. */
+typedef StaticTask_t task_buf_t;
+
+/** Word of RTOS task stack. */
+typedef StackType_t task_stack_t;
+
+/** Memory of RTOS queue control block. */
+typedef StaticQueue_t queue_buf_t;
+
+/** Memory of RTOS semaphore control block. */
+typedef StaticSemaphore_t sem_buf_t;
+
+/** Memory of RTOS mutex control block. */
+typedef StaticSemaphore_t mutex_buf_t;
+
+/** Memory of RTOS event group control block. */
+typedef StaticEventGroup_t event_group_buf_t;
+
 #define TEST_ENDLESS_LOOP()
 
 /**
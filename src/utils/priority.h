@@ -17,16 +17,23 @@
  * @{
  */
 
-/** Position estimation task stacksize */
-#define HM_10_AT_INIT_TASK_STACKSIZE (configMINIMAL_STACK_SIZE * 4)
-/** Position estimation task priority */
-#define HM_10_AT_INIT_TASK_PRIORITY (tskIDLE_PRIORITY + 8)
-
-/** SSD1306 initialization stacksize */
-#define SSD1306_INIT_STACKSIZE (configMINIMAL_STACK_SIZE * 2)
-/** SSD1306 initialization priority */
+/** Telemetry receiver priority during hm-10 AT initialization */
+#define HM_10_AT_INIT_PRIORITY (tskIDLE_PRIORITY + 8)
+
+/** Display task priority during ssd1306 initialization */
 #define SSD1306_INIT_PRIORITY (tskIDLE_PRIORITY + 10)
 
+/** SSD1306 flush stacksize */
+#define SSD1306_FLUSH_STACKSIZE (configMINIMAL_STACK_SIZE * 2)
+/** SSD1306 flush priority */
+#define SSD1306_FLUSH_PRIORITY (tskIDLE_PRIORITY + 6)
+
+/** Telemetry receiver stacksize, hm-10 AT initialization runs on it first */
+#define TELEMETRY_STACKSIZE (configMINIMAL_STACK_SIZE * 4)
+
+/** Telemetry receiver priority, above display so snapshot update isn't preempted by reader */
+#define TELEMETRY_PRIORITY (tskIDLE_PRIORITY + 7)
+
 /** Display batter stacksize */
 #define DISPLAY_STACKSIZE (configMINIMAL_STACK_SIZE * 10)
 /** Display battery priority */
@@ -34,10 +41,26 @@
 
 /* USART HW priority */
 #define USART_PRIORITY 8
+/** DMA on USART RX HW priority */
+#define DMA_USART_RX_PRIORITY 8
+/** DMA on USART TX HW priority */
+#define DMA_USART_TX_PRIORITY 8
 /** DMA on I2C TX HW priority */
 #define DMA_I2C_TX_PRIORITY 7
+/** DMA on I2C RX HW priority */
+#define DMA_I2C_RX_PRIORITY 7
+/** DMA on ADC1 battery measurement HW priority */
+#define DMA_BATTERY_PRIORITY 10
+/** Button EXTI HW priority */
+#define EXTI_BUTTON_PRIORITY 10
+/** Button debounce timer HW priority, same as EXTI so they never preempt each other */
+#define TIM_BUTTON_PRIORITY 10
 /** I2C1 Event HW priority */
 #define I2C1_EV_PRIORITY 8
+/** I2C1 Error HW priority */
+#define I2C1_ER_PRIORITY 7
+/** RTC wakeup HW priority, handler only clears flags of idle wakeup timer */
+#define RTC_WAKEUP_PRIORITY 10
 
 /**
  * @}
@@ -0,0 +1,190 @@
+/**
+ * @file ring_buf.c
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Lock-free single producer, single consumer byte ring buffer
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "ring_buf.h"
+#include <string.h>
+
+/* Index counters are published with release and read with acquire order,
+ * so data written before head/tail update is visible to the other side. */
+#define RING_LOAD(var)       __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#define RING_STORE(var, val) __atomic_store_n(&(var), (val), __ATOMIC_RELEASE)
+
+/**
+ * @brief Notify consumer task if fill level reached threshold
+ *
+ * @param rb - ring buffer
+ * @param yield - set when context switch is needed
+ */
+static void ring_buf_check_threshold_isr(struct ring_buf* rb, int32_t* yield);
+
+int32_t ring_buf_init(struct ring_buf* rb, uint8_t* data, uint32_t size)
+{
+    if((rb == NULL) || (data == NULL) || (size == 0) || ((size & (size - 1)) != 0))
+    {
+        /* Invalid arguments */
+        return -EINVAL;
+    }
+
+    rb->data = data;
+    rb->mask = size - 1;
+    rb->head = 0;
+    rb->tail = 0;
+    rb->notify_task = NULL;
+    rb->threshold = 0;
+
+    return 0;
+}
+
+void ring_buf_set_notify(struct ring_buf* rb, void* task, uint32_t threshold)
+{
+    rb->threshold = threshold;
+    RING_STORE(rb->notify_task, task);
+}
+
+uint32_t ring_buf_count(const struct ring_buf* rb)
+{
+    return RING_LOAD(rb->head) - RING_LOAD(rb->tail);
+}
+
+uint32_t ring_buf_space(const struct ring_buf* rb)
+{
+    return (rb->mask + 1) - ring_buf_count(rb);
+}
+
+uint32_t ring_buf_write_pos(const struct ring_buf* rb)
+{
+    return rb->head;
+}
+
+uint32_t ring_buf_read_pos(const struct ring_buf* rb)
+{
+    return rb->tail;
+}
+
+uint32_t ring_buf_push(struct ring_buf* rb, const uint8_t* src, uint32_t len)
+{
+    uint32_t head = rb->head;
+    uint32_t space = (rb->mask + 1) - (head - RING_LOAD(rb->tail));
+
+    if(len > space)
+    {
+        len = space;
+    }
+
+    /* At most two copies, second one when data wraps around */
+    uint32_t offset = head & rb->mask;
+    uint32_t first = (rb->mask + 1) - offset;
+
+    if(first > len)
+    {
+        first = len;
+    }
+
+    memcpy(&rb->data[offset], src, first);
+    memcpy(rb->data, &src[first], len - first);
+
+    RING_STORE(rb->head, head + len);
+
+    return len;
+}
+
+uint32_t ring_buf_push_isr(struct ring_buf* rb, const uint8_t* src, uint32_t len, int32_t* yield)
+{
+    len = ring_buf_push(rb, src, len);
+    ring_buf_check_threshold_isr(rb, yield);
+
+    return len;
+}
+
+uint32_t ring_buf_write_span(struct ring_buf* rb, uint8_t** span)
+{
+    uint32_t head = rb->head;
+    uint32_t space = (rb->mask + 1) - (head - RING_LOAD(rb->tail));
+    uint32_t offset = head & rb->mask;
+    uint32_t len = (rb->mask + 1) - offset;
+
+    *span = &rb->data[offset];
+
+    return (len < space) ? len : space;
+}
+
+void ring_buf_commit(struct ring_buf* rb, uint32_t len)
+{
+    RING_STORE(rb->head, rb->head + len);
+}
+
+void ring_buf_commit_isr(struct ring_buf* rb, uint32_t len, int32_t* yield)
+{
+    ring_buf_commit(rb, len);
+    ring_buf_check_threshold_isr(rb, yield);
+}
+
+void ring_buf_notify_isr(struct ring_buf* rb, int32_t* yield)
+{
+    void* task = RING_LOAD(rb->notify_task);
+
+    if(task != NULL)
+    {
+        rtos_task_notify_give_isr(task, yield);
+    }
+}
+
+uint32_t ring_buf_pop(struct ring_buf* rb, uint8_t* dst, uint32_t len)
+{
+    uint32_t tail = rb->tail;
+    uint32_t count = RING_LOAD(rb->head) - tail;
+
+    if(len > count)
+    {
+        len = count;
+    }
+
+    /* At most two copies, second one when data wraps around */
+    uint32_t offset = tail & rb->mask;
+    uint32_t first = (rb->mask + 1) - offset;
+
+    if(first > len)
+    {
+        first = len;
+    }
+
+    memcpy(dst, &rb->data[offset], first);
+    memcpy(&dst[first], rb->data, len - first);
+
+    RING_STORE(rb->tail, tail + len);
+
+    return len;
+}
+
+uint32_t ring_buf_read_span(struct ring_buf* rb, const uint8_t** span)
+{
+    uint32_t tail = rb->tail;
+    uint32_t count = RING_LOAD(rb->head) - tail;
+    uint32_t offset = tail & rb->mask;
+    uint32_t len = (rb->mask + 1) - offset;
+
+    *span = &rb->data[offset];
+
+    return (len < count) ? len : count;
+}
+
+void ring_buf_consume(struct ring_buf* rb, uint32_t len)
+{
+    RING_STORE(rb->tail, rb->tail + len);
+}
+
+static void ring_buf_check_threshold_isr(struct ring_buf* rb, int32_t* yield)
+{
+    uint32_t count = ring_buf_count(rb);
+
+    if((count > 0) && (count >= rb->threshold))
+    {
+        ring_buf_notify_isr(rb, yield);
+    }
+}
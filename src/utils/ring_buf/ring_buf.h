@@ -0,0 +1,188 @@
+/**
+ * @file ring_buf.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Lock-free single producer, single consumer byte ring buffer
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _RING_BUF_H_
+#define _RING_BUF_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+#include "platform_specific.h"
+
+/**
+ * @defgroup utils_ring_buf
+ *
+ * Only producer writes head and only consumer writes tail, so one ISR
+ * and one task can use the buffer without critical sections.
+ *
+ * @{
+ */
+
+/**
+ * Ring buffer control structure.
+ */
+struct ring_buf
+{
+    uint8_t* data;       /**< Storage, size is a power of two */
+    uint32_t mask;       /**< Storage size - 1 */
+    uint32_t head;       /**< Free running count of written bytes, producer only */
+    uint32_t tail;       /**< Free running count of read bytes, consumer only */
+    void* notify_task;   /**< Task notified from ISR producer, NULL if none */
+    uint32_t threshold;  /**< Fill level which triggers notification */
+};
+
+/**
+ * @brief Initialize empty ring buffer
+ *
+ * @param rb - ring buffer
+ * @param data - storage
+ * @param size - storage size, power of two
+ * @return int32_t - 0 on success, -EINVAL if size isn't power of two
+ */
+int32_t ring_buf_init(struct ring_buf* rb, uint8_t* data, uint32_t size);
+
+/**
+ * @brief Set task notified when fill level reaches threshold
+ *
+ * Called by consumer, notification is sent by _isr producer functions.
+ *
+ * @param rb - ring buffer
+ * @param task - task handle, NULL disables notification
+ * @param threshold - fill level in bytes
+ */
+void ring_buf_set_notify(struct ring_buf* rb, void* task, uint32_t threshold);
+
+/**
+ * @brief Number of bytes ready to read
+ *
+ * @param rb - ring buffer
+ * @return uint32_t
+ */
+uint32_t ring_buf_count(const struct ring_buf* rb);
+
+/**
+ * @brief Number of bytes which can be written
+ *
+ * @param rb - ring buffer
+ * @return uint32_t
+ */
+uint32_t ring_buf_space(const struct ring_buf* rb);
+
+/**
+ * @brief Free running count of written bytes, producer side
+ *
+ * Lets the producer remember positions in the stream, e.g. where each
+ * chunk ends, to be compared with ring_buf_read_pos() by the consumer.
+ *
+ * @param rb - ring buffer
+ * @return uint32_t
+ */
+uint32_t ring_buf_write_pos(const struct ring_buf* rb);
+
+/**
+ * @brief Free running count of read bytes, consumer side
+ *
+ * @param rb - ring buffer
+ * @return uint32_t
+ */
+uint32_t ring_buf_read_pos(const struct ring_buf* rb);
+
+/**
+ * @brief Copy bytes into buffer, producer side
+ *
+ * @param rb - ring buffer
+ * @param src - bytes to write
+ * @param len - number of bytes
+ * @return uint32_t - number of bytes written, limited by free space
+ */
+uint32_t ring_buf_push(struct ring_buf* rb, const uint8_t* src, uint32_t len);
+
+/**
+ * @brief Copy bytes into buffer from ISR, notifies task on threshold
+ *
+ * @param rb - ring buffer
+ * @param src - bytes to write
+ * @param len - number of bytes
+ * @param yield - set when context switch is needed
+ * @return uint32_t - number of bytes written, limited by free space
+ */
+uint32_t ring_buf_push_isr(struct ring_buf* rb, const uint8_t* src, uint32_t len, int32_t* yield);
+
+/**
+ * @brief Contiguous free space, for writing in place (e.g. by DMA)
+ *
+ * @param rb - ring buffer
+ * @param span - set to the first free byte
+ * @return uint32_t - span length
+ */
+uint32_t ring_buf_write_span(struct ring_buf* rb, uint8_t** span);
+
+/**
+ * @brief Publish bytes written in place, producer side
+ *
+ * @param rb - ring buffer
+ * @param len - number of bytes written
+ */
+void ring_buf_commit(struct ring_buf* rb, uint32_t len);
+
+/**
+ * @brief Publish bytes written in place from ISR, notifies task on threshold
+ *
+ * @param rb - ring buffer
+ * @param len - number of bytes written
+ * @param yield - set when context switch is needed
+ */
+void ring_buf_commit_isr(struct ring_buf* rb, uint32_t len, int32_t* yield);
+
+/**
+ * @brief Notify consumer task from ISR regardless of fill level
+ *
+ * @param rb - ring buffer
+ * @param yield - set when context switch is needed
+ */
+void ring_buf_notify_isr(struct ring_buf* rb, int32_t* yield);
+
+/**
+ * @brief Copy bytes out of buffer, consumer side
+ *
+ * @param rb - ring buffer
+ * @param dst - destination
+ * @param len - max number of bytes
+ * @return uint32_t - number of bytes read
+ */
+uint32_t ring_buf_pop(struct ring_buf* rb, uint8_t* dst, uint32_t len);
+
+/**
+ * @brief Contiguous bytes ready to read, for reading in place (e.g. by DMA)
+ *
+ * @param rb - ring buffer
+ * @param span - set to the first byte to read
+ * @return uint32_t - span length
+ */
+uint32_t ring_buf_read_span(struct ring_buf* rb, const uint8_t** span);
+
+/**
+ * @brief Release bytes read in place, consumer side
+ *
+ * @param rb - ring buffer
+ * @param len - number of bytes read
+ */
+void ring_buf_consume(struct ring_buf* rb, uint32_t len);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _RING_BUF_H_ */
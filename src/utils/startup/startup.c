@@ -0,0 +1,29 @@
+/**
+ * @file startup.c
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Readiness of startup steps
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "startup.h"
+
+/* Bits of finished startup steps, never cleared */
+static event_group_t ready_group;
+static event_group_buf_t ready_group_buf;
+
+void startup_init(void)
+{
+    ready_group = rtos_event_group_create_static(&ready_group_buf);
+}
+
+void startup_ready_set(uint32_t bits)
+{
+    rtos_event_group_set(ready_group, bits);
+}
+
+bool startup_ready_wait(uint32_t bits, uint32_t ms)
+{
+    return (rtos_event_group_wait(ready_group, bits, ms) & bits) == bits;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file startup.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Readiness of startup steps
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _STARTUP_H_
+#define _STARTUP_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+#include "platform_specific.h"
+
+/**
+ * @defgroup utils_startup
+ *
+ * Startup steps run in parallel at the beginning of tasks which own the
+ * initialized hardware, so no task exists only for initialization:
+ *
+ *   system_init() -> display task:   ssd1306 init -> drawing
+ *                 -> telemetry task: hm-10 init   -> STARTUP_READY_BLE -> receiving
+ *
+ * Each step raises priority of its task until it's done. Steps used by
+ * other tasks publish readiness in event group, readers of hm-10 check
+ * STARTUP_READY_BLE before touching the link.
+ *
+ * @{
+ */
+
+/* hm-10 AT initialization finished, result in hm_10_at_report_get() */
+#define STARTUP_READY_BLE (1 << 0)
+
+/**
+ * @brief Create readiness event group, called before scheduler start
+ */
+void startup_init(void);
+
+/**
+ * @brief Mark startup steps as done
+ *
+ * @param bits - STARTUP_READY_ bits
+ */
+void startup_ready_set(uint32_t bits);
+
+/**
+ * @brief Wait for startup steps
+ *
+ * @param bits - STARTUP_READY_ bits, all are waited for
+ * @param ms - time to wait in ms, 0 only checks
+ * @return bool - true when all steps are done
+ */
+bool startup_ready_wait(uint32_t bits, uint32_t ms);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _STARTUP_H_ */
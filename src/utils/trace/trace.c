@@ -0,0 +1,31 @@
+/**
+ * @file trace.c
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Binary trace of RTOS and interrupt events in RAM ring
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "trace.h"
+#include <string.h>
+
+/* Header is valid from reset, so ring can be dumped at any time */
+struct trace_ring trace_ring = {
+    .magic = TRACE_MAGIC,
+    .cpu_freq = configCPU_CLOCK_HZ,
+    .len = TRACE_LEN,
+    .max_tasks = TRACE_MAX_TASKS,
+    .name_len = configMAX_TASK_NAME_LEN,
+    .event_size = sizeof(struct trace_event),
+};
+
+void trace_task_create(uint32_t number, const char* name, uint32_t priority)
+{
+    if((number >= 1) && (number <= TRACE_MAX_TASKS))
+    {
+        strncpy(trace_ring.names[number - 1], name, configMAX_TASK_NAME_LEN);
+    }
+
+    trace_event(TRACE_EVENT_TASK_CREATE, number, priority);
+}
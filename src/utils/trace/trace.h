@@ -0,0 +1,176 @@
+/**
+ * @file trace.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Binary trace of RTOS and interrupt events in RAM ring
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/*
+ * Included at the end of FreeRTOSConfig.h, so no kernel headers here. Config
+ * is included for configMAX_TASK_NAME_LEN by users other than the kernel, its
+ * include guard makes it a no-op when included from the config itself.
+ */
+#include <stdint.h>
+#include "FreeRTOSConfig.h"
+
+/**
+ * @defgroup utils_trace
+ *
+ * Events are timestamped with DWT cycle counter and written to the ring
+ * without locking, so the oldest ones are overwritten. Ring is read by
+ * debugger, e.g. "dump binary value trace.bin trace_ring" in gdb, and
+ * decoded by tools/trace_decode.py.
+ *
+ * @{
+ */
+
+/* Number of events in ring, power of two */
+#define TRACE_LEN 256
+
+/* Number of task names kept, task numbers start from 1 */
+#define TRACE_MAX_TASKS 12
+
+/* First word of ring, "TRC1" */
+#define TRACE_MAGIC 0x31435254
+
+/* DWT cycle counter, started with RTOS run time stats */
+#define TRACE_CYCCNT (*(volatile uint32_t*)0xE0001004UL)
+
+/* Id of RTOS object, low half of its address is unique in 64 KB of RAM */
+#define TRACE_OBJECT_ID(ptr) ((uint16_t)(uintptr_t)(ptr))
+
+/**
+ * Event types, meaning of id and arg in comments.
+ */
+enum trace_event_type
+{
+    TRACE_EVENT_ISR_ENTER = 1,      /**< enum cpu_stats_isr, - */
+    TRACE_EVENT_ISR_EXIT,           /**< enum cpu_stats_isr, - */
+    TRACE_EVENT_TASK_SWITCH,        /**< task number, priority */
+    TRACE_EVENT_TASK_CREATE,        /**< task number, priority */
+    TRACE_EVENT_TASK_DELETE,        /**< task number, - */
+    TRACE_EVENT_QUEUE_SEND,         /**< queue type, queue id */
+    TRACE_EVENT_QUEUE_SEND_ISR,     /**< queue type, queue id */
+    TRACE_EVENT_QUEUE_SEND_FAIL,    /**< queue type, queue id */
+    TRACE_EVENT_QUEUE_RECEIVE,      /**< queue type, queue id */
+    TRACE_EVENT_QUEUE_RECEIVE_ISR,  /**< queue type, queue id */
+    TRACE_EVENT_QUEUE_RECEIVE_FAIL, /**< queue type, queue id */
+    TRACE_EVENT_QUEUE_BLOCK,        /**< queue type, queue id */
+    TRACE_EVENT_NOTIFY,             /**< notified task number, - */
+    TRACE_EVENT_NOTIFY_ISR,         /**< notified task number, - */
+    TRACE_EVENT_NOTIFY_BLOCK,       /**< waiting task number, - */
+    TRACE_EVENT_IDLE_SLEEP,         /**< -, - */
+    TRACE_EVENT_IDLE_WAKEUP,        /**< -, - */
+    TRACE_EVENT_USER,               /**< marker, value */
+};
+
+/**
+ * Single event, 8 bytes.
+ */
+struct trace_event
+{
+    uint32_t time; /**< DWT cycle counter */
+    uint8_t type;  /**< enum trace_event_type */
+    uint8_t id;    /**< Event source */
+    uint16_t arg;  /**< Event argument */
+};
+
+/**
+ * Ring with header describing it for decoder.
+ */
+struct trace_ring
+{
+    uint32_t magic;                                       /**< TRACE_MAGIC */
+    uint32_t cpu_freq;                                    /**< Cycle counter frequency in Hz */
+    uint16_t len;                                         /**< TRACE_LEN */
+    uint16_t max_tasks;                                   /**< TRACE_MAX_TASKS */
+    uint16_t name_len;                                    /**< configMAX_TASK_NAME_LEN */
+    uint16_t event_size;                                  /**< sizeof(struct trace_event) */
+    uint32_t head;                                        /**< Free running count of written events */
+    char names[TRACE_MAX_TASKS][configMAX_TASK_NAME_LEN]; /**< Task names, index is task number - 1 */
+    struct trace_event events[TRACE_LEN];                 /**< Events, the oldest at head % TRACE_LEN when full */
+};
+
+extern struct trace_ring trace_ring;
+
+/**
+ * @brief Record event
+ *
+ * Slot is reserved atomically, so event may be written from any context.
+ *
+ * @param type - enum trace_event_type
+ * @param id - event source
+ * @param arg - event argument
+ */
+static inline void trace_event(uint8_t type, uint8_t id, uint16_t arg)
+{
+    struct trace_event* event = &trace_ring.events[__atomic_fetch_add(&trace_ring.head, 1, __ATOMIC_RELAXED) & (TRACE_LEN - 1)];
+
+    event->time = TRACE_CYCCNT;
+    event->type = type;
+    event->id = id;
+    event->arg = arg;
+}
+
+/**
+ * @brief Record user marker
+ *
+ * @param marker - marker chosen by caller
+ * @param value - value shown with marker
+ */
+static inline void trace_user(uint8_t marker, uint16_t value)
+{
+    trace_event(TRACE_EVENT_USER, marker, value);
+}
+
+/**
+ * @brief Record task creation and keep its name for decoder
+ *
+ * @param number - task number
+ * @param name - task name
+ * @param priority - task priority
+ */
+void trace_task_create(uint32_t number, const char* name, uint32_t priority);
+
+/* RTOS trace hooks, expanded inside kernel sources */
+#define traceTASK_SWITCHED_IN() trace_event(TRACE_EVENT_TASK_SWITCH, pxCurrentTCB->uxTCBNumber, pxCurrentTCB->uxPriority)
+#define traceTASK_CREATE(tcb) trace_task_create((tcb)->uxTCBNumber, (tcb)->pcTaskName, (tcb)->uxPriority)
+#define traceTASK_DELETE(tcb) trace_event(TRACE_EVENT_TASK_DELETE, (tcb)->uxTCBNumber, 0)
+
+#define traceQUEUE_SEND(queue) trace_event(TRACE_EVENT_QUEUE_SEND, (queue)->ucQueueType, TRACE_OBJECT_ID(queue))
+#define traceQUEUE_SEND_FROM_ISR(queue) trace_event(TRACE_EVENT_QUEUE_SEND_ISR, (queue)->ucQueueType, TRACE_OBJECT_ID(queue))
+#define traceQUEUE_SEND_FAILED(queue) trace_event(TRACE_EVENT_QUEUE_SEND_FAIL, (queue)->ucQueueType, TRACE_OBJECT_ID(queue))
+#define traceQUEUE_RECEIVE(queue) trace_event(TRACE_EVENT_QUEUE_RECEIVE, (queue)->ucQueueType, TRACE_OBJECT_ID(queue))
+#define traceQUEUE_RECEIVE_FROM_ISR(queue) trace_event(TRACE_EVENT_QUEUE_RECEIVE_ISR, (queue)->ucQueueType, TRACE_OBJECT_ID(queue))
+#define traceQUEUE_RECEIVE_FAILED(queue) trace_event(TRACE_EVENT_QUEUE_RECEIVE_FAIL, (queue)->ucQueueType, TRACE_OBJECT_ID(queue))
+#define traceBLOCKING_ON_QUEUE_SEND(queue) trace_event(TRACE_EVENT_QUEUE_BLOCK, (queue)->ucQueueType, TRACE_OBJECT_ID(queue))
+#define traceBLOCKING_ON_QUEUE_RECEIVE(queue) trace_event(TRACE_EVENT_QUEUE_BLOCK, (queue)->ucQueueType, TRACE_OBJECT_ID(queue))
+
+#define traceTASK_NOTIFY() trace_event(TRACE_EVENT_NOTIFY, pxTCB->uxTCBNumber, 0)
+#define traceTASK_NOTIFY_FROM_ISR() trace_event(TRACE_EVENT_NOTIFY_ISR, pxTCB->uxTCBNumber, 0)
+#define traceTASK_NOTIFY_GIVE_FROM_ISR() trace_event(TRACE_EVENT_NOTIFY_ISR, pxTCB->uxTCBNumber, 0)
+#define traceTASK_NOTIFY_TAKE_BLOCK() trace_event(TRACE_EVENT_NOTIFY_BLOCK, pxCurrentTCB->uxTCBNumber, 0)
+#define traceTASK_NOTIFY_WAIT_BLOCK() trace_event(TRACE_EVENT_NOTIFY_BLOCK, pxCurrentTCB->uxTCBNumber, 0)
+
+#define traceLOW_POWER_IDLE_BEGIN() trace_event(TRACE_EVENT_IDLE_SLEEP, 0, 0)
+#define traceLOW_POWER_IDLE_END() trace_event(TRACE_EVENT_IDLE_WAKEUP, 0, 0)
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _TRACE_H_ */
@@ -0,0 +1,104 @@
+/******************************************************************************
+ *brief: ring_buf throughput benchmark, producer and consumer in two threads
+ *author: cF-embedded.pl
+ ******************************************************************************/
+
+extern "C"
+{
+#include "ring_buf.h"
+}
+
+#include <chrono>
+#include <cstdio>
+#include <initializer_list>
+#include <thread>
+
+void mock_task_notify_give_isr(void* task, int32_t* yield)
+{
+    (void)task;
+    *yield = 1;
+}
+
+/** Bytes moved through the buffer in each run */
+static constexpr uint64_t TOTAL_BYTES = 16ULL * 1024 * 1024;
+
+/**
+ * Move TOTAL_BYTES through ring of given size in chunks, verify the
+ * sequence on consumer side and print throughput.
+ */
+static bool run(uint32_t size, uint32_t chunk)
+{
+    static uint8_t storage[4096];
+    struct ring_buf rb;
+    bool valid = true;
+
+    ring_buf_init(&rb, storage, size);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread producer([&]() {
+        uint8_t src[256];
+        uint8_t seq = 0;
+        uint64_t sent = 0;
+
+        while(sent < TOTAL_BYTES)
+        {
+            for(uint32_t i = 0; i < chunk; i++)
+            {
+                src[i] = seq + i;
+            }
+
+            uint32_t n = ring_buf_push(&rb, src, chunk);
+            seq += n;
+            sent += n;
+
+            /* Bytes not pushed are regenerated in the next round */
+            if(n == 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint8_t dst[256];
+    uint8_t seq = 0;
+    uint64_t received = 0;
+
+    while(received < TOTAL_BYTES)
+    {
+        uint32_t n = ring_buf_pop(&rb, dst, chunk);
+
+        if(n == 0)
+        {
+            std::this_thread::yield();
+        }
+
+        for(uint32_t i = 0; i < n; i++)
+        {
+            valid &= (dst[i] == seq++);
+        }
+        received += n;
+    }
+
+    producer.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("size %4u chunk %3u: %8.1f MB/s %s\n", size, chunk, TOTAL_BYTES / elapsed.count() / 1e6, valid ? "" : "DATA CORRUPTED");
+
+    return valid;
+}
+
+int main(void)
+{
+    bool valid = true;
+
+    for(uint32_t size : {256u, 4096u})
+    {
+        for(uint32_t chunk : {1u, 16u, 64u, 256u})
+        {
+            valid &= run(size, chunk);
+        }
+    }
+
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,35 @@
+/**
+ * @file platform_specific.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Host replacement of platform definitions for unit tests
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _PLATFORM_SPECIFIC_H_
+#define _PLATFORM_SPECIFIC_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/** Symbols private in production are visible for tests */
+#define PRIVATE
+
+/** Task notification recorded by the mock */
+void mock_task_notify_give_isr(void* task, int32_t* yield);
+
+#define rtos_task_notify_give_isr(task, yield) mock_task_notify_give_isr(task, yield)
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _PLATFORM_SPECIFIC_H_ */
@@ -0,0 +1,211 @@
+/******************************************************************************
+ *brief: ring_buf unit tests
+ *author: cF-embedded.pl
+ ******************************************************************************/
+
+extern "C"
+{
+#include "ring_buf.h"
+}
+
+#include <gtest/gtest.h>
+
+static void* notified_task;
+static int32_t notify_count;
+
+void mock_task_notify_give_isr(void* task, int32_t* yield)
+{
+    notified_task = task;
+    notify_count++;
+    *yield = 1;
+}
+
+class ring_buf_test : public ::testing::Test
+{
+  protected:
+    static constexpr uint32_t SIZE = 16;
+
+    uint8_t storage[SIZE];
+    struct ring_buf rb;
+
+    void SetUp() override
+    {
+        notified_task = NULL;
+        notify_count = 0;
+        ASSERT_EQ(0, ring_buf_init(&rb, storage, SIZE));
+    }
+
+    void TearDown() override {}
+};
+
+TEST_F(ring_buf_test, init_rejects_size_not_power_of_two)
+{
+    ASSERT_EQ(-EINVAL, ring_buf_init(&rb, storage, 12));
+    ASSERT_EQ(-EINVAL, ring_buf_init(&rb, storage, 0));
+    ASSERT_EQ(-EINVAL, ring_buf_init(&rb, NULL, SIZE));
+}
+
+TEST_F(ring_buf_test, empty_after_init)
+{
+    ASSERT_EQ(0u, ring_buf_count(&rb));
+    ASSERT_EQ(SIZE, ring_buf_space(&rb));
+}
+
+TEST_F(ring_buf_test, push_pop_keeps_order)
+{
+    uint8_t in[] = {1, 2, 3, 4, 5};
+    uint8_t out[5] = {0};
+
+    ASSERT_EQ(5u, ring_buf_push(&rb, in, 5));
+    ASSERT_EQ(5u, ring_buf_count(&rb));
+    ASSERT_EQ(5u, ring_buf_pop(&rb, out, 5));
+    ASSERT_EQ(0, memcmp(in, out, 5));
+    ASSERT_EQ(0u, ring_buf_count(&rb));
+}
+
+TEST_F(ring_buf_test, push_limited_by_space)
+{
+    uint8_t in[SIZE + 4] = {0};
+
+    ASSERT_EQ(SIZE, ring_buf_push(&rb, in, sizeof(in)));
+    ASSERT_EQ(0u, ring_buf_space(&rb));
+    ASSERT_EQ(0u, ring_buf_push(&rb, in, 1));
+}
+
+TEST_F(ring_buf_test, pop_limited_by_count)
+{
+    uint8_t in[] = {7, 8};
+    uint8_t out[8];
+
+    ring_buf_push(&rb, in, 2);
+    ASSERT_EQ(2u, ring_buf_pop(&rb, out, sizeof(out)));
+    ASSERT_EQ(0u, ring_buf_pop(&rb, out, sizeof(out)));
+}
+
+TEST_F(ring_buf_test, bulk_copy_wraps_around)
+{
+    uint8_t in[12];
+    uint8_t out[12];
+
+    for(uint8_t i = 0; i < sizeof(in); i++)
+    {
+        in[i] = i + 100;
+    }
+
+    /* Move indexes close to the end of storage */
+    ring_buf_push(&rb, in, 10);
+    ring_buf_pop(&rb, out, 10);
+
+    ASSERT_EQ(12u, ring_buf_push(&rb, in, 12));
+    ASSERT_EQ(12u, ring_buf_pop(&rb, out, 12));
+    ASSERT_EQ(0, memcmp(in, out, 12));
+}
+
+TEST_F(ring_buf_test, spans_are_contiguous_up_to_storage_end)
+{
+    uint8_t in[10] = {0};
+    uint8_t* wspan;
+    const uint8_t* rspan;
+
+    ring_buf_push(&rb, in, 10);
+    ring_buf_pop(&rb, in, 4);
+
+    /* 6 free bytes till the end of storage, 4 more after wrap */
+    ASSERT_EQ(6u, ring_buf_write_span(&rb, &wspan));
+    ASSERT_EQ(&storage[10], wspan);
+
+    ASSERT_EQ(6u, ring_buf_read_span(&rb, &rspan));
+    ASSERT_EQ(&storage[4], rspan);
+
+    ring_buf_commit(&rb, 6);
+    ASSERT_EQ(4u, ring_buf_write_span(&rb, &wspan));
+    ASSERT_EQ(&storage[0], wspan);
+
+    ring_buf_consume(&rb, 6);
+    ASSERT_EQ(6u, ring_buf_read_span(&rb, &rspan));
+    ASSERT_EQ(&storage[10], rspan);
+}
+
+TEST_F(ring_buf_test, indexes_survive_counter_overflow)
+{
+    uint8_t in[6] = {1, 2, 3, 4, 5, 6};
+    uint8_t out[6];
+
+    rb.head = UINT32_MAX - 2;
+    rb.tail = UINT32_MAX - 2;
+
+    ASSERT_EQ(6u, ring_buf_push(&rb, in, 6));
+    ASSERT_EQ(6u, ring_buf_count(&rb));
+    ASSERT_EQ(6u, ring_buf_pop(&rb, out, 6));
+    ASSERT_EQ(0, memcmp(in, out, 6));
+}
+
+TEST_F(ring_buf_test, positions_count_written_and_read_bytes)
+{
+    uint8_t in[SIZE] = {0};
+    uint8_t out[SIZE];
+    const uint8_t* rspan;
+
+    rb.head = UINT32_MAX - 2;
+    rb.tail = UINT32_MAX - 2;
+
+    ASSERT_EQ(10u, ring_buf_push(&rb, in, 10));
+    ASSERT_EQ(UINT32_MAX - 2 + 10, ring_buf_write_pos(&rb));
+    ASSERT_EQ(UINT32_MAX - 2, ring_buf_read_pos(&rb));
+
+    ASSERT_EQ(4u, ring_buf_pop(&rb, out, 4));
+    ring_buf_consume(&rb, ring_buf_read_span(&rb, &rspan));
+    ASSERT_EQ(ring_buf_write_pos(&rb), ring_buf_read_pos(&rb));
+}
+
+TEST_F(ring_buf_test, isr_push_notifies_on_threshold)
+{
+    uint8_t in[4] = {0};
+    int32_t yield = 0;
+    int task;
+
+    ring_buf_set_notify(&rb, &task, 4);
+
+    ring_buf_push_isr(&rb, in, 3, &yield);
+    ASSERT_EQ(0, notify_count);
+    ASSERT_EQ(0, yield);
+
+    ring_buf_push_isr(&rb, in, 1, &yield);
+    ASSERT_EQ(1, notify_count);
+    ASSERT_EQ(&task, notified_task);
+    ASSERT_EQ(1, yield);
+}
+
+TEST_F(ring_buf_test, isr_commit_notifies_on_threshold)
+{
+    int32_t yield = 0;
+    int task;
+
+    ring_buf_set_notify(&rb, &task, 8);
+
+    ring_buf_commit_isr(&rb, 7, &yield);
+    ASSERT_EQ(0, notify_count);
+
+    ring_buf_commit_isr(&rb, 1, &yield);
+    ASSERT_EQ(1, notify_count);
+}
+
+TEST_F(ring_buf_test, no_notification_without_task)
+{
+    uint8_t in[4] = {0};
+    int32_t yield = 0;
+
+    ring_buf_push_isr(&rb, in, 4, &yield);
+    ring_buf_notify_isr(&rb, &yield);
+    ASSERT_EQ(0, notify_count);
+}
+
+TEST_F(ring_buf_test, forced_notification_ignores_threshold)
+{
+    int32_t yield = 0;
+    int task;
+
+    ring_buf_set_notify(&rb, &task, 8);
+    ring_buf_notify_isr(&rb, &yield);
+    ASSERT_EQ(1, notify_count);
+}
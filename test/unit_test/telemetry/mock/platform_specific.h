@@ -0,0 +1,40 @@
+/**
+ * @file platform_specific.h
+ * @author cF-embedded (cf@embedded.pl)
+ * @brief Host replacement of platform definitions for unit tests
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#ifndef _PLATFORM_SPECIFIC_H_
+#define _PLATFORM_SPECIFIC_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+/** Symbols private in production are visible for tests */
+#define PRIVATE
+
+/** Cycle counter used by inline helpers of cpu_stats.h and latency_stats.h, never read by telemetry */
+typedef struct
+{
+    volatile uint32_t CYCCNT;
+} mock_dwt_t;
+
+extern mock_dwt_t mock_dwt;
+
+#define DWT (&mock_dwt)
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* _PLATFORM_SPECIFIC_H_ */
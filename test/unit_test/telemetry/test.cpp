@@ -0,0 +1,318 @@
+/******************************************************************************
+ *brief: telemetry framing unit tests
+ *author: cF-embedded.pl
+ ******************************************************************************/
+
+extern "C"
+{
+#include "telemetry.h"
+}
+
+#include <gtest/gtest.h>
+#include <vector>
+
+class telemetry_test : public ::testing::Test
+{
+  protected:
+    struct telemetry_decoder dec;
+    std::vector<struct telemetry_frame> frames;
+    int32_t broken;
+
+    void SetUp() override
+    {
+        telemetry_decoder_init(&dec);
+        frames.clear();
+        broken = 0;
+    }
+
+    void TearDown() override {}
+
+    /* Encode state frame, returns encoded length */
+    uint32_t encode_state(uint8_t seq, uint16_t speed, uint8_t* buf)
+    {
+        struct telemetry_frame frame;
+        struct telemetry_state state = {speed, 3700, TELEMETRY_STATUS_CHARGING};
+
+        telemetry_state_pack(&frame, &state);
+        frame.seq = seq;
+
+        int32_t len = telemetry_encode(&frame, buf, TELEMETRY_ENCODED_MAX);
+        EXPECT_GT(len, 0);
+
+        return len;
+    }
+
+    /* Feed bytes the way receiver task does, collect decoded and broken frames */
+    void feed(const uint8_t* buf, uint32_t len)
+    {
+        for(uint32_t pos = 0; pos < len;)
+        {
+            struct telemetry_frame frame;
+            uint32_t used;
+            int32_t ret = telemetry_decode(&dec, &buf[pos], len - pos, &frame, &used);
+
+            if(ret == 1)
+            {
+                frames.push_back(frame);
+            }
+            else if(ret == -EBADMSG)
+            {
+                broken++;
+            }
+
+            pos += used;
+        }
+    }
+};
+
+TEST_F(telemetry_test, state_round_trip)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+    struct telemetry_state state;
+    uint32_t len = encode_state(7, 42, buf);
+
+    /* Delimiter only at the end */
+    ASSERT_EQ(TELEMETRY_DELIMITER, buf[len - 1]);
+    ASSERT_EQ(nullptr, memchr(buf, TELEMETRY_DELIMITER, len - 1));
+
+    feed(buf, len);
+
+    ASSERT_EQ(1u, frames.size());
+    ASSERT_EQ(TELEMETRY_TYPE_STATE, frames[0].type);
+    ASSERT_EQ(7, frames[0].seq);
+    ASSERT_EQ(0, telemetry_state_unpack(&frames[0], &state));
+    ASSERT_EQ(42, state.speed);
+    ASSERT_EQ(3700, state.battery_mv);
+    ASSERT_EQ(TELEMETRY_STATUS_CHARGING, state.status);
+    ASSERT_EQ(1u, dec.frames);
+    ASSERT_EQ(0u, dec.errors);
+}
+
+TEST_F(telemetry_test, max_payload_with_zeros_round_trip)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+    struct telemetry_frame frame = {TELEMETRY_TYPE_CPU_TASK, 0, TELEMETRY_PAYLOAD_MAX, {0}};
+
+    for(uint8_t i = 0; i < TELEMETRY_PAYLOAD_MAX; i++)
+    {
+        frame.payload[i] = (i % 3 == 0) ? 0 : i;
+    }
+
+    int32_t len = telemetry_encode(&frame, buf, sizeof(buf));
+    ASSERT_GT(len, 0);
+
+    feed(buf, len);
+
+    ASSERT_EQ(1u, frames.size());
+    ASSERT_EQ(TELEMETRY_PAYLOAD_MAX, frames[0].len);
+    ASSERT_EQ(0, memcmp(frame.payload, frames[0].payload, TELEMETRY_PAYLOAD_MAX));
+}
+
+TEST_F(telemetry_test, byte_by_byte_round_trip)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+    uint32_t len = encode_state(1, 300, buf);
+
+    for(uint32_t i = 0; i < len; i++)
+    {
+        feed(&buf[i], 1);
+    }
+
+    ASSERT_EQ(1u, frames.size());
+    ASSERT_EQ(0, broken);
+}
+
+TEST_F(telemetry_test, decode_stops_after_first_frame)
+{
+    uint8_t buf[2 * TELEMETRY_ENCODED_MAX];
+    uint32_t len = encode_state(1, 10, buf);
+    len += encode_state(2, 20, &buf[len]);
+
+    struct telemetry_frame frame;
+    uint32_t used;
+
+    ASSERT_EQ(1, telemetry_decode(&dec, buf, len, &frame, &used));
+    ASSERT_LT(used, len);
+    ASSERT_EQ(1, frame.seq);
+
+    ASSERT_EQ(1, telemetry_decode(&dec, &buf[used], len - used, &frame, &used));
+    ASSERT_EQ(2, frame.seq);
+}
+
+TEST_F(telemetry_test, encode_rejects_too_long_frame_or_buffer)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+    struct telemetry_frame frame = {TELEMETRY_TYPE_STATE, 0, TELEMETRY_PAYLOAD_MAX + 1, {0}};
+
+    ASSERT_EQ(-EINVAL, telemetry_encode(&frame, buf, sizeof(buf)));
+
+    frame.len = TELEMETRY_STATE_LEN;
+    ASSERT_EQ(-EINVAL, telemetry_encode(&frame, buf, TELEMETRY_STATE_LEN));
+}
+
+TEST_F(telemetry_test, corrupted_crc_is_dropped)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+    uint32_t len = encode_state(1, 42, buf);
+
+    /* Flip bits of last crc byte, never turning it into delimiter */
+    buf[len - 2] ^= (buf[len - 2] == 0x01) ? 0x02 : 0x01;
+
+    feed(buf, len);
+
+    ASSERT_EQ(0u, frames.size());
+    ASSERT_EQ(1, broken);
+    ASSERT_EQ(1u, dec.errors);
+    ASSERT_EQ(0u, dec.frames);
+}
+
+TEST_F(telemetry_test, corrupted_payload_is_dropped)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+    uint32_t len = encode_state(1, 42, buf);
+
+    buf[3] ^= (buf[3] == 0x80) ? 0x40 : 0x80;
+
+    feed(buf, len);
+
+    ASSERT_EQ(0u, frames.size());
+    ASSERT_EQ(1u, dec.errors);
+}
+
+TEST_F(telemetry_test, truncated_frame_is_dropped)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+    uint32_t len = encode_state(1, 42, buf);
+
+    /* Lost middle bytes, delimiter still received */
+    memmove(&buf[2], &buf[5], len - 5);
+    len -= 3;
+
+    feed(buf, len);
+
+    ASSERT_EQ(0u, frames.size());
+    ASSERT_EQ(1u, dec.errors);
+}
+
+TEST_F(telemetry_test, too_short_frame_is_dropped)
+{
+    const uint8_t buf[] = {0x02, 0x01, TELEMETRY_DELIMITER};
+
+    feed(buf, sizeof(buf));
+
+    ASSERT_EQ(0u, frames.size());
+    ASSERT_EQ(1u, dec.errors);
+}
+
+TEST_F(telemetry_test, back_to_back_delimiters_are_ignored)
+{
+    const uint8_t buf[] = {TELEMETRY_DELIMITER, TELEMETRY_DELIMITER, TELEMETRY_DELIMITER};
+
+    feed(buf, sizeof(buf));
+
+    ASSERT_EQ(0u, frames.size());
+    ASSERT_EQ(0u, dec.errors);
+}
+
+TEST_F(telemetry_test, resyncs_on_delimiter_after_garbage)
+{
+    uint8_t buf[3 * TELEMETRY_ENCODED_MAX];
+    uint32_t len = 0;
+
+    /* Receiver started in the middle of a frame */
+    uint8_t first[TELEMETRY_ENCODED_MAX];
+    uint32_t first_len = encode_state(1, 10, first);
+    memcpy(buf, &first[first_len / 2], first_len - first_len / 2);
+    len += first_len - first_len / 2;
+
+    len += encode_state(2, 20, &buf[len]);
+    len += encode_state(3, 30, &buf[len]);
+
+    feed(buf, len);
+
+    ASSERT_EQ(2u, frames.size());
+    ASSERT_EQ(2, frames[0].seq);
+    ASSERT_EQ(3, frames[1].seq);
+    ASSERT_EQ(1u, dec.errors);
+}
+
+TEST_F(telemetry_test, oversized_frame_is_dropped_and_next_decoded)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+    uint8_t junk[2 * TELEMETRY_ENCODED_MAX];
+
+    memset(junk, 0x01, sizeof(junk));
+    junk[sizeof(junk) - 1] = TELEMETRY_DELIMITER;
+    feed(junk, sizeof(junk));
+
+    uint32_t len = encode_state(1, 10, buf);
+    feed(buf, len);
+
+    ASSERT_EQ(1u, frames.size());
+    ASSERT_EQ(1u, dec.errors);
+}
+
+TEST_F(telemetry_test, explicit_resync_drops_frame_in_progress)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+    uint8_t next[TELEMETRY_ENCODED_MAX];
+    uint32_t len = encode_state(1, 10, buf);
+    uint32_t next_len = encode_state(5, 50, next);
+
+    /* Rx overrun, head of frame 1 and tail of frame 4 are received */
+    feed(buf, len / 2);
+    telemetry_decoder_resync(&dec);
+
+    uint8_t tail[TELEMETRY_ENCODED_MAX];
+    uint32_t tail_len = encode_state(4, 40, tail);
+    feed(&tail[tail_len / 2], tail_len - tail_len / 2);
+
+    feed(next, next_len);
+
+    ASSERT_EQ(1u, frames.size());
+    ASSERT_EQ(5, frames[0].seq);
+    ASSERT_EQ(1u, dec.errors);
+}
+
+TEST_F(telemetry_test, resync_keeps_counters_and_sequence)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+
+    feed(buf, encode_state(1, 10, buf));
+    telemetry_decoder_resync(&dec);
+
+    /* Lone delimiter ends the dropped frame */
+    const uint8_t delimiter = TELEMETRY_DELIMITER;
+    feed(&delimiter, 1);
+
+    feed(buf, encode_state(4, 40, buf));
+
+    ASSERT_EQ(2u, dec.frames);
+    ASSERT_EQ(1u, dec.errors);
+    ASSERT_EQ(2u, dec.lost);
+}
+
+TEST_F(telemetry_test, lost_frames_counted_from_sequence)
+{
+    uint8_t buf[TELEMETRY_ENCODED_MAX];
+
+    feed(buf, encode_state(254, 10, buf));
+    feed(buf, encode_state(255, 10, buf));
+    /* Sequence wraps, frames 0 and 1 are missing */
+    feed(buf, encode_state(2, 10, buf));
+
+    ASSERT_EQ(3u, dec.frames);
+    ASSERT_EQ(2u, dec.lost);
+}
+
+TEST_F(telemetry_test, state_unpack_rejects_other_types_and_short_payload)
+{
+    struct telemetry_frame frame = {TELEMETRY_TYPE_CPU_STATS_REQUEST, 0, 0, {0}};
+    struct telemetry_state state;
+
+    ASSERT_EQ(-EBADMSG, telemetry_state_unpack(&frame, &state));
+
+    frame.type = TELEMETRY_TYPE_STATE;
+    frame.len = TELEMETRY_STATE_LEN - 1;
+    ASSERT_EQ(-EBADMSG, telemetry_state_unpack(&frame, &state));
+}